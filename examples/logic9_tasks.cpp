@@ -0,0 +1,102 @@
+/* logic9_tasks.cpp
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include "logic9.h"
+
+/*! Benchmark of task checking for a logic9 population.
+
+ A logic9 population is evolved for a number of updates, after which the most
+ recent (input, input, output) triple of every organism is collected.  So that
+ every task is exercised, triples whose output is each of the logic functions
+ of random inputs are added.  All triples are then checked with the fused
+ task_library::performed() and with the per-task virtual calls of
+ task_library::performed_by_task(), and the two are compared.
+
+ Usage: example-logic9-tasks [updates] [repetitions]
+ */
+int main(int argc, char* argv[]) {
+    int updates = (argc > 1) ? atoi(argv[1]) : 200;
+    int reps = (argc > 2) ? atoi(argv[2]) : 2000;
+
+    metadata md;
+    put<POPULATION_SIZE>(1024,md);
+    put<REPRESENTATION_SIZE>(100,md);
+    put<SPATIAL_X>(32,md);
+    put<SPATIAL_Y>(32,md);
+    put<SCHEDULER_TIME_SLICE>(30,md);
+    put<SCHEDULER_RESOURCE_SLICE>(30,md);
+    put<MUTATION_PER_SITE_P>(0.0075,md);
+    put<MUTATION_INSERTION_P>(0.05,md);
+    put<MUTATION_DELETION_P>(0.05,md);
+    put<RNG_SEED>(1,md);
+
+    ea_type ea(md);
+    generate_initial_population(ea);
+    ea.lifecycle().advance_epoch(updates, ea);
+
+    struct triple { int in0, in1, out0; };
+    std::vector<triple> T;
+    for(ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        if((i->inputs().size() >= 2) && !i->outputs().empty()) {
+            triple t = { i->inputs()[0], i->inputs()[1], i->outputs()[0] };
+            T.push_back(t);
+        }
+    }
+    std::size_t evolved = T.size();
+    for(std::size_t i=0; i<1024; ++i) {
+        int a = ea.rng()(), b = ea.rng()();
+        int f[] = { ~a, ~b, ~(a&b), a&b, a|~b, ~a|b, a|b, a&~b, ~a&b, ~(a|b), a^b, ~(a^b), a };
+        triple t = { a, b, f[i % 13] };
+        T.push_back(t);
+    }
+
+    ea_type::task_library_type& lib = ea.tasklib();
+    task_phenotype::mask_type fused=0, by_task=0;
+
+    std::clock_t start = std::clock();
+    for(int r=0; r<reps; ++r) {
+        for(std::size_t i=0; i<T.size(); ++i) {
+            fused += lib.performed(T[i].in0, T[i].in1, T[i].out0);
+        }
+    }
+    double fused_t = static_cast<double>(std::clock()-start) / CLOCKS_PER_SEC;
+
+    start = std::clock();
+    for(int r=0; r<reps; ++r) {
+        for(std::size_t i=0; i<T.size(); ++i) {
+            by_task += lib.performed_by_task(T[i].in0, T[i].in1, T[i].out0);
+        }
+    }
+    double by_task_t = static_cast<double>(std::clock()-start) / CLOCKS_PER_SEC;
+
+    double n = static_cast<double>(reps) * T.size();
+    std::cout << "triples: " << T.size() << " (" << evolved << " from the population)" << std::endl
+    << "performed_by_task: " << (by_task_t / n * 1e9) << " ns/check" << std::endl
+    << "performed:         " << (fused_t / n * 1e9) << " ns/check" << std::endl
+    << "speedup:           " << (by_task_t / fused_t) << std::endl;
+
+    if(fused != by_task) {
+        std::cerr << "error: task masks differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -26,7 +26,29 @@ namespace ealib {
 	
 	LIBEA_MD_DECL(CHECKPOINT_OFF, "ea.run.checkpoint_off", int);
 	LIBEA_MD_DECL(CHECKPOINT_NAME, "ea.run.checkpoint_name", std::string);
+	LIBEA_MD_DECL(CHECKPOINT_FORMAT, "ea.run.checkpoint_format", std::string); // xml (default) or binary
+	LIBEA_MD_DECL(CHECKPOINT_COMPRESSION, "ea.run.checkpoint_compression", std::string); // none (default), gzip, or zstd
 	
+    namespace checkpoint {
+        
+        /*! Indicates whether Archive is one of the binary checkpoint archives.
+         
+         Types with bulk data (e.g., genomes and the environment's locations)
+         use this to write it as packed arrays and columns in binary
+         checkpoints, while keeping the layout of XML checkpoints unchanged.
+         */
+        template <typename Archive>
+        struct columnar {
+            static const bool value=false;
+        };
+        
+        //! Checkpoint formats.
+        enum format_type { XML, BINARY };
+        
+        //! Checkpoint compression.
+        enum compression_type { NONE, GZIP, ZSTD };
+        
+    } // checkpoint
 } // ealib
 
 /* The mess below is to support a version of ealib that doesn't link against
@@ -45,7 +67,7 @@ namespace ealib {
 		template <typename EA> void load(std::istream& in, EA& ea) { }
 		template <typename EA> void load(const std::string& filename, EA& ea) { }
         template <typename EA> void load(const std::string& filename, const metadata& md, EA& ea) { }
-		template <typename EA> void save(std::ostream& out, EA& ea) { }
+		template <typename EA> void save(std::ostream& out, EA& ea, format_type fmt=XML) { }
 		template <typename EA> void save(const std::string& filename, EA& ea) { }
 		template <typename EA> void save(EA& ea) { }
 	} // checkpoint
@@ -54,43 +76,173 @@ namespace ealib {
 #else
 
 #include <boost/regex.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/xml_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+
+/* zstd compression requires a boost::iostreams that was built with zstd, and
+ linking against libzstd, so it is only available if LIBEA_CHECKPOINT_ZSTD is
+ defined.
+ */
+#ifdef LIBEA_CHECKPOINT_ZSTD
+#include <boost/iostreams/filter/zstd.hpp>
+#endif
 
 #include <ea/exceptions.h>
 
 namespace ealib {
 	namespace checkpoint {
+        
+        template <>
+        struct columnar<boost::archive::binary_oarchive> {
+            static const bool value=true;
+        };
+        
+        template <>
+        struct columnar<boost::archive::binary_iarchive> {
+            static const bool value=true;
+        };
+        
+        /*! Binary checkpoints start with these 8 bytes, followed by the format
+         version as 4 little-endian bytes, and then a boost binary archive.
+         
+         \note Like the binary archive itself, binary checkpoints are only meant
+         to be read on the same platform (and by the same build of ealib) that
+         wrote them; XML checkpoints are portable.
+         */
+        const char BINARY_MAGIC[8]={'E','A','L','I','B','C','P','\0'};
+        
+        //! Version of the binary checkpoint format.
+        const boost::uint32_t BINARY_VERSION=1;
+        
+        //! First byte of a gzip stream.
+        const int GZIP_MAGIC=0x1f;
+        
+        //! First byte of a zstd frame.
+        const int ZSTD_MAGIC=0x28;
+        
+        //! Returns the format of the named checkpoint file: binary if it has a .bin extension (before any compression extension).
+        inline format_type format_of(const std::string& filename) {
+            static const boost::regex e(".*\\.bin(\\.gz|\\.zst)?$");
+            return boost::regex_match(filename, e) ? BINARY : XML;
+        }
+        
+        //! Returns the compression of the named checkpoint file, from its extension.
+        inline compression_type compression_of(const std::string& filename) {
+            static const boost::regex gz(".*\\.gz$");
+            static const boost::regex zst(".*\\.zst$");
+            if(boost::regex_match(filename, gz)) {
+                return GZIP;
+            } else if(boost::regex_match(filename, zst)) {
+                return ZSTD;
+            }
+            return NONE;
+        }
+        
+        namespace detail {
+            
+            //! Pushes a decompressor for c onto f.
+            inline void push_decompressor(compression_type c, boost::iostreams::filtering_stream<boost::iostreams::input>& f) {
+                namespace bio = boost::iostreams;
+                switch(c) {
+                    case GZIP: f.push(bio::gzip_decompressor()); break;
+#ifdef LIBEA_CHECKPOINT_ZSTD
+                    case ZSTD: f.push(bio::zstd_decompressor()); break;
+#else
+                    case ZSTD: throw file_io_exception("zstd-compressed checkpoints require LIBEA_CHECKPOINT_ZSTD.");
+#endif
+                    default: break;
+                }
+            }
+            
+            //! Pushes a compressor for c onto f.
+            inline void push_compressor(compression_type c, boost::iostreams::filtering_stream<boost::iostreams::output>& f) {
+                namespace bio = boost::iostreams;
+                switch(c) {
+                    case GZIP: f.push(bio::gzip_compressor()); break;
+#ifdef LIBEA_CHECKPOINT_ZSTD
+                    case ZSTD: f.push(bio::zstd_compressor()); break;
+#else
+                    case ZSTD: throw file_io_exception("zstd-compressed checkpoints require LIBEA_CHECKPOINT_ZSTD.");
+#endif
+                    default: break;
+                }
+            }
+            
+            //! Writes the header of a binary checkpoint.
+            inline void write_header(std::ostream& out) {
+                out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+                for(std::size_t i=0; i<4; ++i) {
+                    out.put(static_cast<char>((BINARY_VERSION >> (8*i)) & 0xff));
+                }
+            }
+            
+            //! Reads and checks the header of a binary checkpoint.
+            inline void read_header(std::istream& in) {
+                char magic[sizeof(BINARY_MAGIC)];
+                unsigned char v[4];
+                in.read(magic, sizeof(magic));
+                in.read(reinterpret_cast<char*>(v), sizeof(v));
+                if(!in.good() || (std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0)) {
+                    throw file_io_exception("not a binary checkpoint.");
+                }
+                boost::uint32_t version = v[0] | (v[1] << 8) | (v[2] << 16) | (static_cast<boost::uint32_t>(v[3]) << 24);
+                if(version > BINARY_VERSION) {
+                    throw file_io_exception("unsupported binary checkpoint version.");
+                }
+            }
+            
+        } // detail
 		
-		//! Load an EA from the given input stream.
+		/*! Load an EA from the given input stream, which may hold either an XML
+         or a binary checkpoint (binary checkpoints are detected by their
+         header).
+         */
 		template <typename EA>
 		void load(std::istream& in, EA& ea, const metadata& md=metadata()) {
-			boost::archive::xml_iarchive ia(in);
-			ia >> BOOST_SERIALIZATION_NVP(ea);
+            if(in.peek() == BINARY_MAGIC[0]) {
+                detail::read_header(in);
+                boost::archive::binary_iarchive ia(in);
+                ia >> BOOST_SERIALIZATION_NVP(ea);
+            } else {
+                boost::archive::xml_iarchive ia(in);
+                ia >> BOOST_SERIALIZATION_NVP(ea);
+            }
 			ea.initialize(md);
 		}
 		
-		//! Load an EA from the given checkpoint file.
+		/*! Load an EA from the given checkpoint file.
+         
+         The format and compression of the file are detected from its contents,
+         not its name.
+         */
 		template <typename EA>
 		void load(const std::string& filename, EA& ea, const metadata& md=metadata()) {
-			std::ifstream ifs(filename.c_str());
+			std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
 			if(!ifs.good()) {
 				throw file_io_exception("could not open " + filename + " for reading.");
 			}
 			std::cerr << "loading " << filename << "... ";
 			
-			// is this a gzipped file?  test by checking file extension...
-			static const boost::regex e(".*\\.gz$");
-			if(boost::regex_match(filename, e)) {
+            compression_type c=NONE;
+            switch(ifs.peek()) {
+                case GZIP_MAGIC: c = GZIP; break;
+                case ZSTD_MAGIC: c = ZSTD; break;
+                default: break;
+            }
+			if(c != NONE) {
 				namespace bio = boost::iostreams;
 				bio::filtering_stream<bio::input> f;
-				f.push(bio::gzip_decompressor());
+                detail::push_decompressor(c, f);
 				f.push(ifs);
 				load(f, ea, md);
 			} else {
@@ -99,24 +251,43 @@ namespace ealib {
 			std::cerr << "done." << std::endl;
 		}
 		
-		//! Save an EA to the given output stream.
+		//! Save an EA to the given output stream in the given format.
 		template <typename EA>
-		void save(std::ostream& out, EA& ea) {
-			boost::archive::xml_oarchive oa(out);
-			oa << BOOST_SERIALIZATION_NVP(ea);
+		void save(std::ostream& out, EA& ea, format_type fmt=XML) {
+            if(fmt == BINARY) {
+                detail::write_header(out);
+                boost::archive::binary_oarchive oa(out);
+                oa << BOOST_SERIALIZATION_NVP(ea);
+            } else {
+                boost::archive::xml_oarchive oa(out);
+                oa << BOOST_SERIALIZATION_NVP(ea);
+            }
 		}
 		
-		//! Save an EA to the given checkpoint file.
+		/*! Save an EA to the given checkpoint file, in the format and with the
+         compression given by its extension (see format_of and compression_of).
+         */
 		template <typename EA>
 		void save(const std::string& filename, EA& ea) {
-			std::ofstream ofs(filename.c_str());
+			std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
 			if(!ofs.good()) {
 				throw file_io_exception("could not open " + filename + " for writing.");
 			}
-			save(ofs,ea);
+            compression_type c=compression_of(filename);
+            if(c != NONE) {
+                namespace bio = boost::iostreams;
+                bio::filtering_stream<bio::output> f;
+                detail::push_compressor(c, f);
+                f.push(ofs);
+                save(f, ea, format_of(filename));
+            } else {
+                save(ofs, ea, format_of(filename));
+            }
 		}
 		
-		//! Save an EA to a generated checkpoint file.
+		/*! Save an EA to a generated checkpoint file; its extension is chosen
+         by the CHECKPOINT_FORMAT and CHECKPOINT_COMPRESSION meta-data.
+         */
 		template <typename EA>
 		void save(EA& ea) {
             if(!get<CHECKPOINT_OFF>(ea,0)) {
@@ -125,7 +296,19 @@ namespace ealib {
                     fname = get<CHECKPOINT_NAME>(ea);
                 } else {
                     std::ostringstream filename;
-                    filename << "checkpoint-" << ea.current_update() << ".xml";
+                    filename << "checkpoint-" << ea.current_update();
+                    if(exists<CHECKPOINT_FORMAT>(ea) && (get<CHECKPOINT_FORMAT>(ea) == "binary")) {
+                        filename << ".bin";
+                    } else {
+                        filename << ".xml";
+                    }
+                    if(exists<CHECKPOINT_COMPRESSION>(ea)) {
+                        if(get<CHECKPOINT_COMPRESSION>(ea) == "gzip") {
+                            filename << ".gz";
+                        } else if(get<CHECKPOINT_COMPRESSION>(ea) == "zstd") {
+                            filename << ".zst";
+                        }
+                    }
                     fname = filename.str();
                 }
                 save(fname, ea);
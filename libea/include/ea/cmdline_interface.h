@@ -198,7 +198,7 @@ namespace ealib {
             cmdline_only_options.add_options()
             ("help,h", "produce this help message")
             ("config,c", po::value<string>(), "ealib configuration file")
-            ("checkpoint,l", po::value<string>(), "load a checkpoint file")
+            ("checkpoint,l", po::value<string>(), "load a checkpoint file (XML or binary, optionally compressed)")
             ("analyze", po::value<string>(), "analyze the results of this EA")
             ("verbose", "output configuration options and per-update time and memory usage")
             ("merge_checkpoint,mc", po::value<string>(), "load an archived population and a checkpoint file");
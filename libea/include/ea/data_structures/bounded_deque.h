@@ -0,0 +1,125 @@
+/* bounded_deque.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATA_STRUCTURES_BOUNDED_DEQUE_H_
+#define _EA_DATA_STRUCTURES_BOUNDED_DEQUE_H_
+
+#include <cassert>
+#include <cstddef>
+
+namespace ealib {
+
+    /*! Double-ended queue with a fixed capacity of N elements, stored inline.
+
+     This is a ring buffer: pushing and popping at either end never allocates.
+     Pushing onto a full bounded_deque is an error; callers decide what to do
+     when full() is true (e.g., drop the new element, or pop the other end).
+     */
+    template <typename T, std::size_t N>
+    class bounded_deque {
+    public:
+        typedef T value_type;
+
+        //! Constructor.
+        bounded_deque() : _h(0), _n(0) {
+        }
+
+        //! Returns the number of elements.
+        std::size_t size() const { return _n; }
+
+        //! Returns the capacity.
+        static std::size_t capacity() { return N; }
+
+        //! Returns true if empty.
+        bool empty() const { return _n == 0; }
+
+        //! Returns true if full.
+        bool full() const { return _n == N; }
+
+        //! Removes all elements.
+        void clear() { _h = _n = 0; }
+
+        //! Returns element i (0 is the front).
+        T& operator[](std::size_t i) { assert(i < _n); return _d[slot(i)]; }
+
+        //! Returns element i (0 is the front; const-qualified).
+        const T& operator[](std::size_t i) const { assert(i < _n); return _d[slot(i)]; }
+
+        //! Returns the front element.
+        T& front() { return operator[](0); }
+
+        //! Returns the back element.
+        T& back() { return operator[](_n-1); }
+
+        //! Adds x to the back.
+        void push_back(const T& x) {
+            assert(!full());
+            _d[slot(_n)] = x;
+            ++_n;
+        }
+
+        //! Adds x to the front.
+        void push_front(const T& x) {
+            assert(!full());
+            _h = (_h == 0) ? (N-1) : (_h-1);
+            _d[_h] = x;
+            ++_n;
+        }
+
+        //! Removes the front element.
+        void pop_front() {
+            assert(!empty());
+            _h = slot(1);
+            --_n;
+        }
+
+        //! Removes the back element.
+        void pop_back() {
+            assert(!empty());
+            --_n;
+        }
+
+        //! Returns true if both contain the same elements, in the same order.
+        bool operator==(const bounded_deque& that) const {
+            if(_n != that._n) {
+                return false;
+            }
+            for(std::size_t i=0; i<_n; ++i) {
+                if(!(operator[](i) == that[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    protected:
+        //! Returns the slot that holds element i.
+        std::size_t slot(std::size_t i) const {
+            i += _h;
+            return (i >= N) ? (i-N) : i;
+        }
+
+        T _d[N]; //!< Storage.
+        std::size_t _h; //!< Slot of the front element.
+        std::size_t _n; //!< Number of elements.
+    };
+
+} // ealib
+
+#endif
@@ -0,0 +1,149 @@
+/* fenwick_tree.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATA_STRUCTURES_FENWICK_TREE_H_
+#define _EA_DATA_STRUCTURES_FENWICK_TREE_H_
+
+#include <cassert>
+#include <vector>
+
+namespace ealib {
+
+    /*! Fenwick (binary indexed) tree over the non-negative weights of slots
+     [0,n).
+
+     Setting a weight, computing the total weight, and finding the slot that
+     covers a given point in the cumulative weight all take O(log n); building
+     the tree from a sequence of weights takes O(n).  This is used for sampling
+     slots in proportion to their weight.
+
+     The total is built up from changes in weight, so it can be left slightly
+     off zero by rounding once every weight is zero; nonzero() is exact, and
+     should be used to tell whether any slot can be sampled.
+     */
+    class fenwick_tree {
+    public:
+        //! Constructor.
+        fenwick_tree() : _nonzero(0) {
+        }
+
+        //! Rebuild this tree from the weights [f,l).
+        template <typename ForwardIterator>
+        void assign(ForwardIterator f, ForwardIterator l) {
+            _w.assign(f, l);
+            _t.assign(_w.size()+1, 0.0);
+            _nonzero = 0;
+            for(std::size_t i=1; i<_t.size(); ++i) {
+                _t[i] += _w[i-1];
+                if(_w[i-1] > 0.0) {
+                    ++_nonzero;
+                }
+                std::size_t j = i + (i & (~i+1));
+                if(j < _t.size()) {
+                    _t[j] += _t[i];
+                }
+            }
+        }
+
+        //! Removes all slots.
+        void clear() {
+            _w.clear();
+            _t.clear();
+            _nonzero = 0;
+        }
+
+        //! Returns the number of slots.
+        std::size_t size() const {
+            return _w.size();
+        }
+
+        //! Returns the number of slots with nonzero weight.
+        std::size_t nonzero() const {
+            return _nonzero;
+        }
+
+        //! Returns the weight of slot i.
+        double weight(std::size_t i) const {
+            assert(i < _w.size());
+            return _w[i];
+        }
+
+        //! Sets the weight of slot i to w.
+        void update(std::size_t i, double w) {
+            assert(i < _w.size());
+            double d = w - _w[i];
+            _nonzero += (w > 0.0) - (_w[i] > 0.0);
+            _w[i] = w;
+            for(std::size_t j=i+1; j<_t.size(); j += (j & (~j+1))) {
+                _t[j] += d;
+            }
+        }
+
+        //! Returns the total weight of all slots.
+        double total() const {
+            double s=0.0;
+            for(std::size_t j=_w.size(); j>0; j -= (j & (~j+1))) {
+                s += _t[j];
+            }
+            return s;
+        }
+
+        /*! Returns the slot i such that the total weight of slots [0,i) is at
+         most u, and the total weight of slots [0,i] is greater than u.
+
+         u must be in [0,total()).  Slots with zero weight are never returned,
+         except when rounding pushes u past the last slot with nonzero weight,
+         in which case that slot is returned.
+         */
+        std::size_t find(double u) const {
+            std::size_t i=0;
+            std::size_t step=1;
+            while((step << 1) < _t.size()) {
+                step <<= 1;
+            }
+            for( ; step>0; step >>= 1) {
+                std::size_t j = i + step;
+                if((j < _t.size()) && (_t[j] <= u)) {
+                    i = j;
+                    u -= _t[j];
+                }
+            }
+            // i is the number of slots with cumulative weight <= u:
+            while((i < _w.size()) && (_w[i] <= 0.0)) {
+                ++i;
+            }
+            if(i >= _w.size()) {
+                assert(!_w.empty());
+                i = _w.size()-1;
+                while((i > 0) && (_w[i] <= 0.0)) {
+                    --i;
+                }
+            }
+            return i;
+        }
+
+    protected:
+        std::vector<double> _w; //!< Weight of each slot.
+        std::vector<double> _t; //!< Tree; _t[j] is the weight of slots (j-lowbit(j),j].
+        std::size_t _nonzero; //!< Number of slots with nonzero weight.
+    };
+
+} // ealib
+
+#endif
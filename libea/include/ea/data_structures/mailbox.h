@@ -0,0 +1,227 @@
+/* mailbox.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATA_STRUCTURES_MAILBOX_H_
+#define _EA_DATA_STRUCTURES_MAILBOX_H_
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <cstddef>
+#include <utility>
+
+namespace ealib {
+
+    /*! Bounded mailbox of (label, data) messages, with a fixed capacity of N
+     messages stored inline.
+
+     This is a ring buffer that keeps the N most recent messages: when it is
+     full, depositing a message drops the oldest one.  Any number of threads may
+     push() at once, while only the mailbox's owner may pop() or otherwise
+     inspect it.
+
+     Each message takes a ticket from a shared counter, which picks its slot.
+     Slots are stamped with the ticket of the message they hold, so the owner
+     can tell a message from one that has overwritten it.  Senders never wait
+     on each other, unless N messages to the same mailbox are in flight at
+     once (at which point the newer of two messages for a slot waits for the
+     older to be written, and then overwrites it).
+     */
+    template <std::size_t N>
+    class mailbox {
+    public:
+        typedef std::pair<int,int> value_type;
+
+        //! Constructor.
+        mailbox() : _head(0), _tail(0) {
+            for(std::size_t i=0; i<N; ++i) {
+                _slots[i].seq.store(0, boost::memory_order_relaxed);
+            }
+        }
+
+        //! Copy constructor.
+        mailbox(const mailbox& that) : _head(0), _tail(0) {
+            for(std::size_t i=0; i<N; ++i) {
+                _slots[i].seq.store(0, boost::memory_order_relaxed);
+            }
+            copy(that);
+        }
+
+        //! Assignment operator.
+        mailbox& operator=(const mailbox& that) {
+            if(this != &that) {
+                clear();
+                copy(that);
+            }
+            return *this;
+        }
+
+        //! Returns the capacity.
+        static std::size_t capacity() { return N; }
+
+        //! Returns the number of messages.
+        std::size_t size() const {
+            boost::uint64_t t=_tail.load(boost::memory_order_acquire);
+            return static_cast<std::size_t>(t - first(t));
+        }
+
+        //! Returns true if empty.
+        bool empty() const { return size() == 0; }
+
+        //! Removes all messages.
+        void clear() {
+            _head = _tail.load(boost::memory_order_acquire);
+        }
+
+        //! Deposits message m, dropping the oldest message if full; safe for concurrent callers.
+        void push(const value_type& m) {
+            boost::uint64_t t=_tail.fetch_add(1, boost::memory_order_acq_rel);
+            slot& s=_slots[t % N];
+            boost::uint64_t q=s.seq.load(boost::memory_order_acquire);
+            for(;;) {
+                if(q >= writing(t)) {
+                    return; // a newer message has this slot; ours is already dropped
+                }
+                if((q & 1) == 0) {
+                    if(s.seq.compare_exchange_weak(q, writing(t), boost::memory_order_acq_rel, boost::memory_order_acquire)) {
+                        break;
+                    }
+                } else {
+                    q = s.seq.load(boost::memory_order_acquire);
+                }
+            }
+            s.msg.store(pack(m), boost::memory_order_release);
+            s.seq.store(written(t), boost::memory_order_release);
+        }
+
+        /*! Removes the oldest message into m, returning false if there is none;
+         a message that is still being written is not yet in the mailbox.
+         */
+        bool pop(value_type& m) {
+            for(;;) {
+                boost::uint64_t t=_tail.load(boost::memory_order_acquire);
+                _head = first(t);
+                if(_head == t) {
+                    return false;
+                }
+                int r=read(_head, m);
+                if(r < 0) {
+                    return false;
+                }
+                ++_head;
+                if(r > 0) {
+                    return true;
+                }
+            }
+        }
+
+        //! Returns true if both contain the same messages, in the same order.
+        bool operator==(const mailbox& that) const {
+            value_type a[N], b[N];
+            std::size_t n=snapshot(a), m=that.snapshot(b);
+            if(n != m) {
+                return false;
+            }
+            for(std::size_t i=0; i<n; ++i) {
+                if(a[i] != b[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /*! Copies the messages into r (which must have room for N), oldest
+         first, and returns how many there are.
+         */
+        std::size_t snapshot(value_type* r) const {
+            boost::uint64_t t=_tail.load(boost::memory_order_acquire);
+            std::size_t n=0;
+            for(boost::uint64_t h=first(t); h!=t; ++h) {
+                if(read(h, r[n]) > 0) {
+                    ++n;
+                }
+            }
+            return n;
+        }
+
+    protected:
+        //! A slot; seq is 0 if never written, and otherwise writing() or written() for the ticket of its message.
+        struct slot {
+            boost::atomic<boost::uint64_t> seq;
+            boost::atomic<boost::uint64_t> msg;
+        };
+
+        //! Returns the stamp of a slot being written with the message of ticket t.
+        static boost::uint64_t writing(boost::uint64_t t) { return 2*t + 1; }
+
+        //! Returns the stamp of a slot holding the message of ticket t.
+        static boost::uint64_t written(boost::uint64_t t) { return 2*t + 2; }
+
+        //! Packs a message into a word.
+        static boost::uint64_t pack(const value_type& m) {
+            return (static_cast<boost::uint64_t>(static_cast<boost::uint32_t>(m.first)) << 32)
+            | static_cast<boost::uint32_t>(m.second);
+        }
+
+        //! Unpacks a message from a word.
+        static value_type unpack(boost::uint64_t w) {
+            return std::make_pair(static_cast<int>(static_cast<boost::uint32_t>(w >> 32)),
+                                  static_cast<int>(static_cast<boost::uint32_t>(w)));
+        }
+
+        //! Returns the ticket of the oldest message that may still be held, given tail t.
+        boost::uint64_t first(boost::uint64_t t) const {
+            return ((t - _head) > N) ? (t - N) : _head;
+        }
+
+        /*! Reads the message of ticket t into m; returns 1 if it was read, 0 if
+         it has been dropped, and -1 if it is still being written.
+         */
+        int read(boost::uint64_t t, value_type& m) const {
+            const slot& s=_slots[t % N];
+            boost::uint64_t q=s.seq.load(boost::memory_order_acquire);
+            if(q < written(t)) {
+                return -1;
+            } else if(q > written(t)) {
+                return 0;
+            }
+            boost::uint64_t w=s.msg.load(boost::memory_order_acquire);
+            if(s.seq.load(boost::memory_order_acquire) != q) {
+                return 0;
+            }
+            m = unpack(w);
+            return 1;
+        }
+
+        //! Appends the messages of that mailbox to this one.
+        void copy(const mailbox& that) {
+            value_type r[N];
+            std::size_t n=that.snapshot(r);
+            for(std::size_t i=0; i<n; ++i) {
+                push(r[i]);
+            }
+        }
+
+        slot _slots[N]; //!< Storage.
+        boost::uint64_t _head; //!< Ticket of the next message to pop (owner only).
+        boost::atomic<boost::uint64_t> _tail; //!< Ticket of the next message to push.
+    };
+
+} // ealib
+
+#endif
@@ -0,0 +1,141 @@
+/* rank_index.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATA_STRUCTURES_RANK_INDEX_H_
+#define _EA_DATA_STRUCTURES_RANK_INDEX_H_
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ranked_index.hpp>
+#include <cassert>
+#include <vector>
+
+namespace ealib {
+
+    /*! Order-statistic index over the slots [0,n) of a container.
+
+     Each slot is associated with a value, and slots are kept ordered by that
+     value (ascending).  Updating a slot's value, finding the slot with the i'th
+     smallest value, and finding the rank of a slot all take O(log n).
+
+     This is used to track the fitness ranks of individuals in a population
+     without re-sorting it.
+     */
+    class rank_index {
+    public:
+        //! An entry in this index.
+        struct entry {
+            entry(double v, std::size_t s) : value(v), slot(s) { }
+            double value; //!< Value of this slot.
+            std::size_t slot; //!< Slot index.
+        };
+
+        typedef boost::multi_index::multi_index_container
+        < entry
+        , boost::multi_index::indexed_by
+        < boost::multi_index::ranked_non_unique<boost::multi_index::member<entry,double,&entry::value> >
+        >
+        > container_type;
+        typedef container_type::iterator iterator;
+
+        //! Constructor.
+        rank_index() {
+        }
+
+        //! Copy constructor.
+        rank_index(const rank_index& that) {
+            *this = that;
+        }
+
+        //! Assignment operator (slot positions are rebuilt, not copied).
+        rank_index& operator=(const rank_index& that) {
+            if(this != &that) {
+                clear();
+                for(std::size_t i=0; i<that._pos.size(); ++i) {
+                    update(i, that.value(i));
+                }
+            }
+            return *this;
+        }
+
+        //! Removes all slots from this index.
+        void clear() {
+            _c.clear();
+            _pos.clear();
+        }
+
+        //! Returns the number of slots in this index.
+        std::size_t size() const {
+            return _pos.size();
+        }
+
+        /*! Sets the value of slot s, adding slots [size(),s] if needed.
+
+         Newly-added slots other than s have value 0.0.
+         */
+        void update(std::size_t s, double v) {
+            while(_pos.size() <= s) {
+                _pos.push_back(_c.insert(entry(0.0, _pos.size())).first);
+            }
+            _c.modify(_pos[s], set_value(v));
+        }
+
+        //! Returns the value of slot s.
+        double value(std::size_t s) const {
+            assert(s < _pos.size());
+            return _pos[s]->value;
+        }
+
+        //! Returns the slot with the i'th smallest value.
+        std::size_t nth(std::size_t i) const {
+            assert(i < _pos.size());
+            return _c.nth(i)->slot;
+        }
+
+        //! Returns the rank of slot s (0 is the smallest value).
+        std::size_t rank(std::size_t s) const {
+            assert(s < _pos.size());
+            return _c.rank(_pos[s]);
+        }
+
+        //! Returns the slot with the smallest value.
+        std::size_t front() const {
+            return _c.begin()->slot;
+        }
+
+        //! Returns the slot with the largest value.
+        std::size_t back() const {
+            return _c.rbegin()->slot;
+        }
+
+    protected:
+        //! Modifier that sets the value of an entry.
+        struct set_value {
+            set_value(double v) : _v(v) { }
+            void operator()(entry& e) { e.value = _v; }
+            double _v;
+        };
+
+        container_type _c; //!< Slots, ordered by value.
+        std::vector<iterator> _pos; //!< Position of each slot in _c.
+    };
+
+} // ealib
+
+#endif
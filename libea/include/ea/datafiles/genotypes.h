@@ -0,0 +1,149 @@
+/* genotypes.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATAFILES_GENOTYPES_H_
+#define _EA_DATAFILES_GENOTYPES_H_
+
+#include <cmath>
+#include <ea/datafile.h>
+#include <ea/events.h>
+#include <ea/digital_evolution/genotypes.h>
+#include <ea/digital_evolution/test_cpu.h>
+
+namespace ealib {
+    namespace datafiles {
+
+        /*! Datafile for genotype statistics in digital evolution.
+
+         Statistics are gathered from a genotype_table, and so take time
+         proportional to the number of genotypes rather than the number of
+         organisms.  Requires the genotype_trait.
+         */
+        template <typename EA>
+        struct genotypes : record_statistics_event<EA> {
+            typedef typename EA::genotype_table_type table_type;
+
+            genotypes(EA& ea) : record_statistics_event<EA>(ea), _table(ea.genotypes()), _df("genotypes.dat") {
+                _df.add_field("update")
+                .add_field("genotypes")
+                .add_field("entropy")
+                .add_field("dominant_id")
+                .add_field("dominant_abundance")
+                .add_field("dominant_tasks")
+                .add_field("dominant_first_update");
+            }
+
+            virtual ~genotypes() {
+            }
+
+            //! Returns the genotype table.
+            table_type& table() { return _table; }
+
+            virtual void operator()(EA& ea) {
+                std::size_t n=0, living=0;
+                for(typename table_type::iterator i=_table.begin(); i!=_table.end(); ++i) {
+                    std::size_t a=table_type::abundance(*i);
+                    n += a;
+                    living += (a > 0) ? 1 : 0;
+                }
+
+                // genotypic entropy, from abundances:
+                double h=0.0;
+                for(typename table_type::iterator i=_table.begin(); i!=_table.end(); ++i) {
+                    std::size_t a=table_type::abundance(*i);
+                    if(a > 0) {
+                        double p=static_cast<double>(a) / static_cast<double>(n);
+                        h -= p * log2(p);
+                    }
+                }
+
+                typename table_type::iterator d=_table.dominant();
+
+                _df.write(ea.current_update())
+                .write(living)
+                .write(h);
+                if(d != _table.end()) {
+                    std::size_t tasks=0;
+                    for(typename table_type::genotype_type::mask_type m=(*d)->tasks(); m; m &= (m-1)) {
+                        ++tasks;
+                    }
+                    _df.write((*d)->id())
+                    .write(table_type::abundance(*d))
+                    .write(tasks)
+                    .write((*d)->first_update());
+                } else {
+                    _df.write(0).write(0).write(0).write(0);
+                }
+                _df.endl();
+            }
+
+            table_type& _table; //!< Genotype table (shared).
+            datafile _df;
+        };
+
+        /*! Datafile for the phenotype of the dominant genotype, as measured
+         by a test CPU.
+
+         Phenotypes are cached by genome, so a dominant genotype is only run
+         once no matter how long it stays dominant.  Requires the
+         genotype_trait.
+         */
+        template <typename EA>
+        struct dominant_phenotype : record_statistics_event<EA> {
+            typedef typename EA::genotype_table_type table_type;
+
+            dominant_phenotype(EA& ea) : record_statistics_event<EA>(ea), _table(ea.genotypes()), _cpu(ea), _df("dominant_phenotype.dat") {
+                _df.add_field("update")
+                .add_field("dominant_id")
+                .add_field("viable")
+                .add_field("gestation")
+                .add_field("fidelity")
+                .add_field("tasks");
+            }
+
+            virtual ~dominant_phenotype() {
+            }
+
+            //! Returns the genotype table.
+            table_type& table() { return _table; }
+
+            virtual void operator()(EA& ea) {
+                typename table_type::iterator d=_table.dominant();
+                if(d == _table.end()) {
+                    return;
+                }
+                test_phenotype p=_cpu.evaluate((*d)->genome());
+                _df.write(ea.current_update())
+                .write((*d)->id())
+                .write(p.viable)
+                .write(p.cycles)
+                .write(p.fidelity)
+                .write(p.tasks)
+                .endl();
+            }
+
+            table_type& _table; //!< Genotype table (shared).
+            test_cpu<EA> _cpu; //!< Test CPU.
+            datafile _df;
+        };
+
+    } // datafiles
+} // ea
+
+#endif
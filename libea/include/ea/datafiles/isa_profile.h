@@ -0,0 +1,70 @@
+/* isa_profile.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DATAFILES_ISA_PROFILE_H_
+#define _EA_DATAFILES_ISA_PROFILE_H_
+
+#include <ea/datafile.h>
+#include <ea/events.h>
+#include <ea/digital_evolution/instruction_profile.h>
+
+namespace ealib {
+    namespace datafiles {
+        
+        /*! Datafile for per-instruction execution counts, virtual cycles, and
+         estimated wall time in digital evolution.
+         
+         There is one row per instruction per recording; counts are those since
+         the previous recording.
+         */
+        template <typename EA>
+        struct isa_profile : record_statistics_event<EA> {
+            typedef instruction_profile<EA> profile_type;
+            
+            isa_profile(EA& ea) : record_statistics_event<EA>(ea), _profile(ea), _df("isa_profile.dat") {
+                _df.add_field("update")
+                .add_field("instruction")
+                .add_field("executed")
+                .add_field("cycles")
+                .add_field("seconds");
+            }
+            
+            virtual ~isa_profile() {
+            }
+            
+            virtual void operator()(EA& ea) {
+                typename profile_type::counters c=_profile.collect();
+                for(std::size_t i=0; i<ea.isa().size(); ++i) {
+                    _df.write(ea.current_update())
+                    .write(ea.isa()[i]->name())
+                    .write(c.executed[i])
+                    .write(c.cycles[i])
+                    .write(c.seconds[i])
+                    .endl();
+                }
+            }
+            
+            profile_type _profile; //!< Instruction profile.
+            datafile _df;
+        };
+        
+    } // datafiles
+} // ea
+
+#endif
@@ -20,6 +20,8 @@
 #ifndef _EA_DATAFILES_REACTIONS_H_
 #define _EA_DATAFILES_REACTIONS_H_
 
+#include <algorithm>
+#include <vector>
 #include <ea/datafile.h>
 #include <ea/events.h>
 
@@ -52,27 +54,36 @@ namespace ealib {
                          typename EA::task_library_type::task_ptr_type t, // task pointer
                          double r, // resources consumed
                          EA& ea) {
-                _tasks[t->name()] += r;
+                if(t->id() >= _tasks.size()) {
+                    _tasks.resize(t->id()+1, 0.0);
+                }
+                _tasks[t->id()] += r;
+            }
+            
+            //! Returns the resources consumed by the named task.
+            double consumed(const std::string& name, EA& ea) {
+                typename EA::task_library_type::task_ptr_type t=ea.tasklib().task(name);
+                return (t && (t->id() < _tasks.size())) ? _tasks[t->id()] : 0.0;
             }
             
             virtual void operator()(EA& ea) {
                 _df.write(ea.current_update())
-                .write(_tasks["not"])
-                .write(_tasks["nand"])
-                .write(_tasks["and"])
-                .write(_tasks["ornot"])
-                .write(_tasks["or"])
-                .write(_tasks["andnot"])
-                .write(_tasks["nor"])
-                .write(_tasks["xor"])
-                .write(_tasks["equals"])
+                .write(consumed("not",ea))
+                .write(consumed("nand",ea))
+                .write(consumed("and",ea))
+                .write(consumed("ornot",ea))
+                .write(consumed("or",ea))
+                .write(consumed("andnot",ea))
+                .write(consumed("nor",ea))
+                .write(consumed("xor",ea))
+                .write(consumed("equals",ea))
                 .endl();
-                _tasks.clear();
+                std::fill(_tasks.begin(), _tasks.end(), 0.0);
             }
             
             datafile _df;
             boost::signals2::scoped_connection _conn2;
-            std::map<std::string, double> _tasks;
+            std::vector<double> _tasks; //!< Resources consumed, by task ID.
         };
 
     } // datafiles
@@ -25,6 +25,7 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <ea/ancestors.h>
 #include <ea/checkpoint.h>
@@ -33,11 +34,17 @@
 #include <ea/digital_evolution/events.h>
 #include <ea/digital_evolution/ancestors.h>
 #include <ea/digital_evolution/environment.h>
+#include <ea/digital_evolution/genotypes.h>
+#include <ea/digital_evolution/sparse_environment.h>
+#include <ea/digital_evolution/instruction_profile.h>
 #include <ea/digital_evolution/instruction_set.h>
 #include <ea/digital_evolution/organism.h>
 #include <ea/digital_evolution/schedulers.h>
+#include <ea/digital_evolution/tiled_scheduler.h>
 #include <ea/digital_evolution/replication.h>
 #include <ea/digital_evolution/task_library.h>
+#include <ea/digital_evolution/test_cpu.h>
+#include <ea/digital_evolution/trace.h>
 #include <ea/digital_evolution/resources.h>
 #include <ea/metadata.h>
 #include <ea/lifecycle.h>
@@ -62,7 +69,9 @@ namespace ealib {
      
      A final complicating factor is that individuals in digital evolution interact
      through an "environment."  Such environments are typically responsible for
-     handling topology, resource gradients, etc.
+     handling topology, resource gradients, etc.  The default environment is a
+     dense torus; sparse_environment is better suited to very large worlds that
+     are mostly empty.
 
      In general, the design of this class is based on concepts from the Avida
      platform for digital evolution~\cite{ofria2004}.
@@ -80,6 +89,7 @@ namespace ealib {
     , typename StopCondition=dont_stop
     , typename PopulationGenerator=generate_single_ancestor
     , template <typename> class IndividualTraits=null_trait
+    , template <typename> class Environment=environment
     > class digital_evolution {
     public:
         typedef singlePopulationS population_structure_tag;
@@ -100,7 +110,7 @@ namespace ealib {
         typedef metadata md_type;
         typedef default_rng_type rng_type;
         typedef digital_evolution_event_handler<digital_evolution> event_handler_type;
-        typedef environment<digital_evolution> environment_type;
+        typedef Environment<digital_evolution> environment_type;
         typedef typename environment_type::location_type location_type;
         typedef typename environment_type::location_iterator location_iterator;
         typedef typename environment_type::neighborhood_iterator neighborhood_iterator;
@@ -109,11 +119,30 @@ namespace ealib {
         typedef shared_ptr_vector<individual_ptr_type> population_type;
         typedef resource_vector<digital_evolution> resources_type;
         typedef typename resources_type::resource_ptr_type resource_ptr_type;
+        typedef execution_trace<digital_evolution> trace_type;
+        typedef instruction_profile<digital_evolution> profile_type;
+        typedef genotype_table<digital_evolution> genotype_table_type;
         typedef boost::indirect_iterator<typename population_type::iterator> iterator;
         typedef boost::indirect_iterator<typename population_type::const_iterator> const_iterator;
         typedef boost::indirect_iterator<typename population_type::reverse_iterator> reverse_iterator;
         typedef boost::indirect_iterator<typename population_type::const_reverse_iterator> const_reverse_iterator;
         
+        /*! State that is local to a thread running part of an update (see
+         tiled_round_robin).
+         
+         While a local_state is installed on the calling thread, rng(), md(),
+         and events() return its members instead of this EA's, and offspring
+         placed by replace() are appended to its offspring list instead of the
+         population.  The scheduler is responsible for merging these back into
+         the EA.
+         */
+        struct local_state {
+            rng_type rng; //!< Random number generator.
+            md_type md; //!< Copy of the EA's meta-data.
+            event_handler_type events; //!< Event handler.
+            population_type offspring; //!< Offspring born on this thread.
+        };
+        
         /*! Similar to the letter/envelope idiom, here we're defining a type
          that is used to hold the guts of a digital_evolution instance.  The
          problem we're trying to solve here is that we have to provide a way
@@ -127,7 +156,7 @@ namespace ealib {
         class state_type {
         public:
             //! Default constructor.
-            state_type() : update(0) {
+            state_type() : update(0), trace(0), profile(0), local(&no_cleanup), localized(false) {
             }
             
             // assignable:
@@ -145,10 +174,21 @@ namespace ealib {
             
             // these have to be handled carefully:
             population_type population; //!< Population instance.
+            population_type recycled; //!< Dead individuals kept for reuse (see recycle()).
             environment_type env; //!< Environment object.
             scheduler_type scheduler; //!< Scheduler instance.
+            trace_type* trace; //!< Execution trace, if any (not owned).
+            profile_type* profile; //!< Instruction profile, if any (not owned).
+            boost::shared_ptr<genotype_table_type> genotypes; //!< Genotype table, if any (see genotypes()).
+            
+            // thread-local state, which is owned by the scheduler:
+            boost::thread_specific_ptr<local_state> local; //!< Local state of the calling thread.
+            bool localized; //!< True if local state may be installed on any thread.
 
         private:
+            //! Local state is not deleted when it is uninstalled.
+            static void no_cleanup(local_state*) { }
+            
             state_type(const state_type&);
             state_type& operator=(const state_type&);
             
@@ -239,15 +279,7 @@ namespace ealib {
             if(!_state) {
                 _state.reset(new state_type());
                 _state->md = md;
-                
-                if(exists<RNG_SEED>(*this)) {
-                    _state->rng.reset(get<RNG_SEED>(*this));
-                } else {
-                    unsigned int s = _state->rng.seed();
-                    _state->rng.reset(s);
-                    put<RNG_SEED>(s, *this);
-                }
-                
+                seed_rng();
                 _state->env.initialize(*this);
             } else {
                 _state->md += md;
@@ -256,6 +288,12 @@ namespace ealib {
             // for a stateful scheduler, need something like this:
             // _state->scheduler.initialize(*this);
             _state->lifecycle.after_initialization(*this);
+            
+            // phenotypes from version 0 checkpoints name their tasks, which are
+            // only now known:
+            for(iterator i=begin(); i!=end(); ++i) {
+                i->phenotype().resolve(_state->tasklib);
+            }
         }
         
         //! Marks the beginning of a new epoch.
@@ -288,6 +326,38 @@ namespace ealib {
             return p;
         }
         
+        /*! Builds an individual from the representation [f,l), reusing a
+         recycled individual if there is one.
+         
+         Recycled individuals are not reused while thread-local state is
+         enabled, since they are shared by all threads.
+         */
+        template <typename ForwardIterator>
+        individual_ptr_type make_individual(ForwardIterator f, ForwardIterator l) {
+            if(_state->recycled.empty() || _state->localized) {
+                individual_ptr_type p(new individual_type(f,l));
+                return p;
+            }
+            individual_ptr_type p;
+            p.swap(_state->recycled.back());
+            _state->recycled.pop_back();
+            p->reset(f,l);
+            return p;
+        }
+        
+        /*! Keeps dead individual p for reuse by make_individual, if nothing else
+         refers to it; p is reset in either case.  Its traits are released now,
+         rather than when it is reused.
+         */
+        void recycle(individual_ptr_type& p) {
+            if(p.unique() && !_state->localized) {
+                p->traits() = typename individual_type::traits_type();
+                _state->recycled.push_back(individual_ptr_type());
+                _state->recycled.back().swap(p);
+            }
+            p.reset();
+        }
+        
         //! Builds an individual from the given representation.
         individual_ptr_type copy_individual(const individual_type& ind) {
             individual_ptr_type p(new individual_type(ind));
@@ -303,13 +373,13 @@ namespace ealib {
         unsigned long current_update() { return _state->update; }
         
         //! Returns the random number generator.
-        rng_type& rng() { return _state->rng; }
+        rng_type& rng() { return localized() ? _state->local->rng : _state->rng; }
         
         //! Returns this EA's meta-data.
-        md_type& md() { return _state->md; }
+        md_type& md() { return localized() ? _state->local->md : _state->md; }
         
         //! Returns this EA's meta-data (const-qualified).
-        const md_type& md() const { return _state->md; }
+        const md_type& md() const { return localized() ? _state->local->md : _state->md; }
         
         //! Retrieves this AL's environment.
         environment_type& env() { return _state->env; }
@@ -318,7 +388,22 @@ namespace ealib {
         bool stop() { return _state->stop(*this); }
         
         //! Returns the event handler.
-        event_handler_type& events() { return _state->events; }
+        event_handler_type& events() { return localized() ? _state->local->events : _state->events; }
+        
+        /*! Enables (or disables) thread-local state.
+         
+         This must be called on the main thread, while no other threads are
+         running code against this EA.
+         */
+        void enable_local_state(bool b) { _state->localized = b; }
+        
+        /*! Installs local state s for the calling thread, or uninstalls it if s
+         is 0.  Ownership of s is retained by the caller.
+         */
+        void localize(local_state* s) { _state->local.reset(s); }
+        
+        //! Returns true if the calling thread has local state installed.
+        bool localized() const { return _state->localized && (_state->local.get() != 0); }
         
         //! Returns the lifecycle.
         lifecycle_type& lifecycle() { return _state->lifecycle; }
@@ -329,6 +414,29 @@ namespace ealib {
         //! Retrieves this AL's instruction set architecture.
         isa_type& isa() { return _state->isa; }
         
+        //! Returns the execution trace attached to this EA (0 if none).
+        trace_type* trace() { return _state->trace; }
+        
+        //! Attaches execution trace t to this EA (0 detaches).
+        void trace(trace_type* t) { _state->trace = t; }
+        
+        //! Returns the instruction profile attached to this EA (0 if none).
+        profile_type* profile() { return _state->profile; }
+        
+        //! Attaches instruction profile t to this EA (0 detaches).
+        void profile(profile_type* t) { _state->profile = t; }
+        
+        /*! Returns this EA's genotype table, which is built on first use, and
+         is then shared by everything that tracks genotypes (an organism can
+         only belong to one).  Requires the genotype_trait.
+         */
+        genotype_table_type& genotypes() {
+            if(!_state->genotypes) {
+                _state->genotypes.reset(new genotype_table_type(*this));
+            }
+            return *_state->genotypes;
+        }
+        
         //! Retrieves this AL's task library.
         task_library_type& tasklib() { return _state->tasklib; }
         
@@ -403,12 +511,38 @@ namespace ealib {
             _state->population.erase(f.base(), l.base());
         }
         
-        //! Erases all individuals in this EA.
+        //! Erases all individuals in this EA (recycling those that nothing else refers to).
         void clear() {
             _state->env.clear(*this);
+            for(typename population_type::iterator i=_state->population.begin(); i!=_state->population.end(); ++i) {
+                recycle(*i);
+            }
             _state->population.clear();
         }
         
+        /*! Returns this EA to the state that initialize(md) would have left a
+         new instance in, e.g., to reuse a subpopulation that has died.
+         
+         The population is erased, and the update, meta-data, RNG, environment
+         (including location data and metadata) and resource levels are reset.
+         The event handler, instruction set, tasks, and lifecycle are kept, as
+         they were configured by initialization.
+         */
+        void reset(const metadata& md) {
+            clear();
+            _state->update = 0;
+            _state->md = md;
+            seed_rng();
+            _state->stop = stop_condition_type();
+            _state->env.ldata().reset();
+            for(std::size_t i=0; i<get<SPATIAL_X>(*this); ++i) {
+                for(std::size_t j=0; j<get<SPATIAL_Y>(*this); ++j) {
+                    _state->env.location(i,j).md().clear();
+                }
+            }
+            _state->resources.reset();
+        }
+        
         //! (Re-)Place an offspring in the population, if possible.
         void replace(individual_ptr_type parent, individual_ptr_type offspring) {
             replacement_type r;
@@ -417,12 +551,27 @@ namespace ealib {
             if(l.second) {
                 _state->env.replace(l.first, offspring, *this);
                 offspring->priority() = parent->priority();
-                _state->population.insert(_state->population.end(), offspring);
-                _state->events.birth(*offspring, *parent, *this);
+                if(localized()) {
+                    _state->local->offspring.push_back(offspring);
+                } else {
+                    _state->population.insert(_state->population.end(), offspring);
+                }
+                events().birth(*offspring, *parent, *this);
             }
         }
         
     protected:
+        //! Seeds the RNG from RNG_SEED, choosing (and saving) a seed if there is none.
+        void seed_rng() {
+            if(exists<RNG_SEED>(*this)) {
+                _state->rng.reset(get<RNG_SEED>(*this));
+            } else {
+                unsigned int s = _state->rng.seed();
+                _state->rng.reset(s);
+                put<RNG_SEED>(s, *this);
+            }
+        }
+        
         boost::scoped_ptr<state_type> _state; //!< Pointer to this EA's letter.
         
     private:
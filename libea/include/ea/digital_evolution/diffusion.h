@@ -0,0 +1,197 @@
+/* digital_evolution/diffusion.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester, Heather J. Goldsby.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EA_DIGITAL_EVOLUTION_DIFFUSION_H_
+#define _EA_DIGITAL_EVOLUTION_DIFFUSION_H_
+
+#include <boost/align/aligned_allocator.hpp>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <ea/parallel.h>
+
+namespace ealib {
+
+    /*! Double-buffered 2D grid for explicit (forward Euler) diffusion.
+
+     The grid has size1() rows and size2() columns, including a one-cell
+     boundary all the way around; only interior cells are changed by sweep().
+     Rows are stored contiguously, each padded to a whole number of cache lines
+     and aligned to a cache line, so that the inner loop of the stencil runs
+     over unit-stride, aligned memory and can be vectorized by the compiler.
+
+     Each cell of the next grid depends only on the current grid, so
+     sweeping any partition of the rows (or columns) in any order, on any number
+     of threads, gives exactly the same result as a single sweep.
+     */
+    class diffusion_grid {
+    public:
+        typedef std::vector<double, boost::alignment::aligned_allocator<double,64> > buffer_type;
+
+        //! Number of doubles per (64-byte) cache line.
+        const static std::size_t LINE=8;
+
+        //! Width of the column tiles used by sweep(), in doubles.
+        const static std::size_t TILE=512;
+
+        //! Constructor.
+        diffusion_grid() : _size1(0), _size2(0), _stride(0) {
+        }
+
+        //! Resize this grid to n rows and m columns (including boundaries).
+        void resize(std::size_t n, std::size_t m) {
+            _size1 = n;
+            _size2 = m;
+            _stride = ((m + LINE - 1) / LINE) * LINE;
+            _R.assign(_size1*_stride, 0.0);
+            _T.assign(_size1*_stride, 0.0);
+        }
+
+        //! Returns the number of rows.
+        std::size_t size1() const { return _size1; }
+
+        //! Returns the number of columns.
+        std::size_t size2() const { return _size2; }
+
+        //! Returns the current level of cell (i,j).
+        double& operator()(std::size_t i, std::size_t j) {
+            assert((i < _size1) && (j < _size2));
+            return _R[i*_stride + j];
+        }
+
+        //! Sets all cells, including boundaries, in both buffers to v.
+        void fill(double v) {
+            std::fill(_R.begin(), _R.end(), v);
+            std::fill(_T.begin(), _T.end(), v);
+        }
+
+        /*! Computes rows [b,e) of the next grid from the current one, with
+         diffusion coefficient k (i.e., delta_t * D):
+
+         next(i,j) = cur(i,j) + k * (uxx + uyy), where
+         uxx = cur(i+1,j) - 2*cur(i,j) + cur(i-1,j), and
+         uyy = cur(i,j+1) - 2*cur(i,j) + cur(i,j-1).
+
+         Boundary cells in rows [b,e) are carried over unchanged.
+         */
+        void sweep(double k, std::size_t b, std::size_t e) {
+            const std::size_t m=_size2-1;
+            if(b == 0) {
+                std::copy(&_R[0], &_R[0]+_size2, &_T[0]);
+                b = 1;
+            }
+            if(e >= _size1) {
+                e = _size1-1;
+                std::copy(&_R[e*_stride], &_R[e*_stride]+_size2, &_T[e*_stride]);
+            }
+            for(std::size_t i=b; i<e; ++i) {
+                _T[i*_stride] = _R[i*_stride];
+                _T[i*_stride+m] = _R[i*_stride+m];
+            }
+
+            for(std::size_t jb=1; jb<m; jb+=TILE) {
+                const std::size_t je=std::min(jb+TILE, m);
+                for(std::size_t i=b; i<e; ++i) {
+                    const double* up=&_R[(i-1)*_stride];
+                    const double* c=&_R[i*_stride];
+                    const double* dn=&_R[(i+1)*_stride];
+                    double* t=&_T[i*_stride];
+                    for(std::size_t j=jb; j<je; ++j) {
+                        double uxx = dn[j] - 2*c[j] + up[j];
+                        double uyy = c[j+1] - 2*c[j] + c[j-1];
+                        t[j] = c[j] + k * (uxx+uyy);
+                    }
+                }
+            }
+        }
+
+        //! Makes the next grid current.
+        void swap() {
+            _R.swap(_T);
+        }
+
+    protected:
+        std::size_t _size1; //!< Number of rows.
+        std::size_t _size2; //!< Number of columns.
+        std::size_t _stride; //!< Distance between rows, in doubles.
+        buffer_type _R; //!< Current levels.
+        buffer_type _T; //!< Next levels.
+    };
+
+
+    /*! Advances several diffusion grids by one step in a single pass.
+
+     All grids must have the same number of rows.  Rows are split into
+     contiguous chunks, one per thread, and each chunk is swept for every grid
+     before moving on; the result does not depend on the number of threads.
+     Threads are only used when there are at least min_cells cells in
+     total, since small grids are faster to sweep than to hand out.
+     */
+    class diffusion_pass {
+    public:
+        //! Default minimum number of cells that are swept in parallel.
+        const static std::size_t MIN_PARALLEL_CELLS=1<<16;
+
+        //! Constructor.
+        diffusion_pass(std::size_t threads=1, std::size_t min_cells=MIN_PARALLEL_CELLS)
+        : _threads(threads), _min_cells(min_cells) {
+        }
+
+        //! Adds grid g, with diffusion coefficient k, to this pass.
+        void add(diffusion_grid& g, double k) {
+            assert(_grids.empty() || (g.size1() == _grids[0]->size1()));
+            _grids.push_back(&g);
+            _k.push_back(k);
+        }
+
+        //! Sweeps rows [b,e) of every grid.
+        void operator()(std::size_t b, std::size_t e, std::size_t) {
+            for(std::size_t i=0; i<_grids.size(); ++i) {
+                _grids[i]->sweep(_k[i], b, e);
+            }
+        }
+
+        //! Advances all grids by one step.
+        void run() {
+            if(_grids.empty()) {
+                return;
+            }
+            std::size_t n=_grids[0]->size1();
+            std::size_t cells=0;
+            for(std::size_t i=0; i<_grids.size(); ++i) {
+                cells += _grids[i]->size1() * _grids[i]->size2();
+            }
+            parallel::for_each_chunk(n, (cells >= _min_cells) ? _threads : 1, *this);
+            for(std::size_t i=0; i<_grids.size(); ++i) {
+                _grids[i]->swap();
+            }
+        }
+
+    protected:
+        std::size_t _threads; //!< Maximum number of threads.
+        std::size_t _min_cells; //!< Minimum number of cells to go parallel.
+        std::vector<diffusion_grid*> _grids; //!< Grids in this pass.
+        std::vector<double> _k; //!< Diffusion coefficient for each grid.
+    };
+
+} // ealib
+
+#endif
@@ -23,15 +23,20 @@
 
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/vector.hpp>
 
+#include <cmath>
+#include <cstdlib>
 #include <utility>
 #include <vector>
 
 #include <ea/algorithm.h>
 #include <ea/metadata.h>
+#include <ea/checkpoint.h>
 #include <ea/data_structures/torus2.h>
+#include <ea/digital_evolution/location_data.h>
 
 namespace ealib {
 
@@ -50,6 +55,11 @@ namespace ealib {
      that r+h gives the coordinates of the location that this position_type is
      facing.
      
+     Headings are always one of the eight unit vectors of the Moore
+     neighborhood, so they can also be described by an index in [0,8), counting
+     counter-clockwise from (1,0); rotations are done on that index, via
+     lookup tables, instead of with rotation matrices.
+     
      \note In some cases, r+h can result in negative values for x or y coordinates.
      That's ok; the environment uses a torus2 for storing locations, which allows
      negative indices.
@@ -81,6 +91,38 @@ namespace ealib {
             return (r[0] == that.r[0]) && (r[1] == that.r[1]) && (h[0] == that.h[0]) && (h[1] == that.h[1]);
         }
         
+        //! Returns the x component of heading i.
+        static int dx(int i) {
+            static const int t[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+            return t[i];
+        }
+        
+        //! Returns the y component of heading i.
+        static int dy(int i) {
+            static const int t[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+            return t[i];
+        }
+        
+        //! Returns the index of this position's heading.
+        int heading() const {
+            static const int t[9] = {5, 4, 3, 6, -1, 2, 7, 0, 1}; // indexed by 3*(x+1) + (y+1)
+            assert((std::abs(h[0]) <= 1) && (std::abs(h[1]) <= 1));
+            assert(t[3*(h[0]+1) + (h[1]+1)] >= 0);
+            return t[3*(h[0]+1) + (h[1]+1)];
+        }
+        
+        //! Sets this position's heading to heading i (mod 8).
+        void heading(int i) {
+            i &= 7;
+            h[0] = dx(i);
+            h[1] = dy(i);
+        }
+        
+        //! Rotate ccw by k*pi/4 radians (k may be negative).
+        void rotate_by(int k) {
+            heading(heading() + k);
+        }
+        
         /*! Rotate this position by matrix R.
 
          Specifically, multiply this position's heading vector h by R.  This
@@ -111,41 +153,29 @@ namespace ealib {
             assert(fabs(h[1]) <= 1);
         }
         
-        //! Rotate by theta radians.
+        //! Rotate by theta radians (rounded to the nearest multiple of pi/4).
         void rotate(double theta) {
-            double R[2][2];
-            R[0][0] = R[1][1] = cos(theta);
-            R[0][1] = -sin(theta);
-            R[1][0] = -R[0][1];
-            rotate(R);
+            rotate_by(static_cast<int>(std::floor(theta / (M_PI/4.0) + 0.5)));
         }
 
         //! Convenience method to rotate ccw by pi/4 radians.
         void rotate_ccw() {
-            static const double R[2][2] = {{0.707, -0.707}, {0.707, 0.707}};
-            rotate(R);
+            rotate_by(1);
         }
         
         //! Convenience method to rotate cw by pi/4 radians.
         void rotate_cw() {
-            static const double R[2][2] = {{0.707, 0.707}, {-0.707, 0.707}};
-            rotate(R);
+            rotate_by(-1);
         }
         
-        /*! Convenience method to rotate ccw by pi/2 radians. For math reasons, rather than using higher radians.
-         You need to call twice. */
+        //! Convenience method to rotate ccw by pi/2 radians.
         void rotate_cardinal_ccw() {
-            static const double R[2][2] = {{0.707, -0.707}, {0.707, 0.707}};
-            rotate(R);
-            rotate(R);
+            rotate_by(2);
         }
         
-        /*! Convenience method to rotate cw by pi/2 radians. For math reasons, rather than using higher radians.
-         You need to call twice. */
+        //! Convenience method to rotate cw by pi/2 radians.
         void rotate_cardinal_cw() {
-            static const double R[2][2] = {{0.707, 0.707}, {-0.707, 0.707}};
-            rotate(R);
-            rotate(R);
+            rotate_by(-2);
         }
 
         //! Serialize this position.
@@ -160,13 +190,34 @@ namespace ealib {
     };
     
     
+    /*! Rotates two neighboring positions to face one another (possibly across
+     the boundary of the torus).
+     */
+    inline void face_positions(position_type& p1, position_type& p2) {
+        int x = p1.r[0] - p2.r[0];
+        if(abs(x) > 1) { // crossing torus boundary
+            x = static_cast<int>(algorithm::copysign(1.0, -x));
+        }
+        
+        int y = p1.r[1] - p2.r[1];
+        if(abs(y) > 1) { // crossing torus boundary
+            y = static_cast<int>(algorithm::copysign(1.0, -y));
+        }
+        
+        // p1.h = (-x,-y)
+        p1.h[0] = -x; p1.h[1] = -y;
+        // p2.h == (x,y)
+        p2.h[0] = x;  p2.h[1] = y;
+    }
+    
+    
     /*! Environment for individuals in a digital evolution algorithm.
      
      This environment provides a 2d torus in which individuals can interact.  It
      is primarily responsible for maintaining a spatial relationship among 
      individuals.  Specifically, the environment can be queried for neighbors.
-     It also provides a mechanism for stigmergy, where each location is itself a
-     metadata container.
+     It also provides two mechanisms for stigmergy: each location is itself a
+     metadata container, and typed per-location fields are available via ldata().
      
      Conceptually, the environment provides a 2d torus of locations.  Each location
      can have at most one individual associated with it (its inhabitant).  The
@@ -187,8 +238,8 @@ namespace ealib {
      By convention, coordinates in the torus are a 2-element array "r", with 
      r[0]==x and r[1]==y.  (Orientations are similar, and called "h").
      
-     \todo It's probably best to do away with a fixed-size torus backing the
-     environment, e.g., it could be replaced with a quadtree, but it works for now.
+     Every location is stored, so memory use is proportional to the area of the
+     environment; see sparse_environment for very large, mostly empty worlds.
      */
     template <typename EA>
     class environment {
@@ -257,42 +308,41 @@ namespace ealib {
         /*! This iterator is used to iterate over the locations in the neighborhood
          of a given location.
          
+         Neighbors are found via the environment's neighbor table, so this is
+         just a cell index, a heading, and a count.
+         
          \note Iteration begins at the currently-faced location, and proceeds ccw.
          */
         struct neighborhood_iterator : boost::iterator_facade<neighborhood_iterator, location_type, boost::single_pass_traversal_tag> {
             //! Constructor.
-            neighborhood_iterator(const position_type& p, int c, location_storage_type& locs)
-            : _pos(p), _count(c), _locs(locs) {
+            neighborhood_iterator(const position_type& p, int c, environment& env)
+            : _cell(env.index(p)), _heading(p.heading()), _count(c), _env(env) {
             }
 
             //! Increment operator.
             void increment() {
-                _pos.rotate_ccw();
                 ++_count;
             }
             
             //! Iterator equality comparison.
             bool equal(const neighborhood_iterator& that) const {
-                return (_count == that._count) && (_pos.r[0] == that._pos.r[0]) && (_pos.r[1] == that._pos.r[1]);
+                return (_count == that._count) && (_cell == that._cell);
             }
             
             //! Dereference this iterator.
             location_type& dereference() const {
-                return _locs(_pos.r[0]+_pos.h[0], _pos.r[1]+_pos.h[1]);
+                return _env._locs.data()[_env.neighbor_index(_cell, _heading + _count)];
             }
             
             //! Get an iterator to the location this neighborhood iterator points to.
             location_iterator make_location_iterator() {
-                location_type& l=dereference();
-                location_iterator i = _locs.data().begin() + _locs.size2()*l.r[0] + l.r[1];
-                assert(l.r[0] == i->r[0]);
-                assert(l.r[1] == i->r[1]);
-                return i;
+                return _env._locs.data().begin() + _env.neighbor_index(_cell, _heading + _count);
             }
 
-            position_type _pos; //!< Position (origin location) of this iterator.
+            std::size_t _cell; //!< Index of the origin location of this iterator.
+            int _heading; //!< Heading of the first neighbor.
             int _count; //!< Increment count for this iterator, used to check end.
-            location_storage_type& _locs; //!< Location storage.
+            environment& _env; //!< Environment.
         };
         
         //! Default constructor.
@@ -314,7 +364,7 @@ namespace ealib {
                     }
                 }
             }
-            return true;
+            return _ldata == that._ldata;
         }
         
         //! Initializes the environment.
@@ -327,9 +377,45 @@ namespace ealib {
                     _locs(i,j).r[1] = j;
                 }
             }
+            index_neighbors();
+            _ldata.resize(_locs.size1()*_locs.size2());
+        }
+        
+        //! Returns the typed data attached to each location (indexed by index()).
+        location_data& ldata() { return _ldata; }
+        
+        //! Returns the index of the location at position pos.
+        std::size_t index(const position_type& pos) const {
+            assert((pos.r[0] >= 0) && (static_cast<std::size_t>(pos.r[0]) < _locs.size1()));
+            assert((pos.r[1] >= 0) && (static_cast<std::size_t>(pos.r[1]) < _locs.size2()));
+            return _locs.size2()*pos.r[0] + pos.r[1];
+        }
+        
+        //! Returns the index of the neighbor of location i in heading h (mod 8).
+        std::size_t neighbor_index(std::size_t i, int h) const {
+            return _neighbors[8*i + (h & 7)];
         }
         
-        //! Clears all individuals from the environment.
+        /*! Build the neighbor table.
+         
+         _neighbors[8*i+h] is the index of the location next to location i in
+         heading h, wrapping around the torus.
+         */
+        void index_neighbors() {
+            const int m=_locs.size1(), n=_locs.size2();
+            _neighbors.resize(8*m*n);
+            for(int x=0; x<m; ++x) {
+                for(int y=0; y<n; ++y) {
+                    for(int h=0; h<8; ++h) {
+                        int nx = (x + position_type::dx(h) + m) % m;
+                        int ny = (y + position_type::dy(h) + n) % n;
+                        _neighbors[8*(n*x+y) + h] = n*nx + ny;
+                    }
+                }
+            }
+        }
+        
+        //! Clears all individuals and typed location data from the environment.
         void clear(EA& ea) {
             assert((get<SPATIAL_X>(ea) * get<SPATIAL_Y>(ea)) <= get<POPULATION_SIZE>(ea));
             _locs.resize(get<SPATIAL_X>(ea), get<SPATIAL_Y>(ea), true);
@@ -338,6 +424,7 @@ namespace ealib {
                     _locs(i,j).p.reset();
                 }
             }
+            _ldata.resize(_locs.size1()*_locs.size2());
         }
         
         
@@ -415,13 +502,14 @@ namespace ealib {
 
         //! Returns a [begin,end) pair of iterators over an individual's neighborhood.
         std::pair<neighborhood_iterator,neighborhood_iterator> neighborhood(individual_type& p) {
-            return std::make_pair(neighborhood_iterator(p.position(), 0, _locs),
-                                  neighborhood_iterator(p.position(), 8, _locs));
+            return std::make_pair(neighborhood_iterator(p.position(), 0, *this),
+                                  neighborhood_iterator(p.position(), 8, *this));
         }
         
         //! Returns an iterator to the location currently faced by an individual.
         location_iterator neighbor(individual_ptr_type p) {
-            return neighborhood_iterator(p->position(), 0, _locs).make_location_iterator();
+            const position_type& pos=p->position();
+            return _locs.data().begin() + neighbor_index(index(pos), pos.heading());
         }
         
         //! Swap individuals (if any) betweeen locations i and j.
@@ -445,27 +533,13 @@ namespace ealib {
         
         //! Rotates two individuals to face one another.
         void face_org(individual_type& ind1, individual_type& ind2) {
-            position_type& p1 = ind1.position();
-            position_type& p2 = ind2.position();
-            
-            int x = p1.r[0] - p2.r[0];
-            if(abs(x) > 1) { // crossing torus boundary
-                x = static_cast<int>(algorithm::copysign(1.0, -x));
-            }
-            
-            int y = p1.r[1] - p2.r[1];
-            if(abs(y) > 1) { // crossing torus boundary
-                y = static_cast<int>(algorithm::copysign(1.0, -y));
-            }
-            
-            // p1.h = (-x,-y)
-            p1.h[0] = -x; p1.h[1] = -y;
-            // p2.h == (x,y)
-            p2.h[0] = x;  p2.h[1] = y;
+            face_positions(ind1.position(), ind2.position());
         }
         
     protected:
         location_storage_type _locs; //!< Torus of locations in this environment.
+        std::vector<std::size_t> _neighbors; //!< Neighbor table, 8 entries per location.
+        location_data _ldata; //!< Typed per-location data.
 
     private:
         environment(const environment&);
@@ -478,11 +552,31 @@ namespace ealib {
             std::size_t size2=_locs.size2();
             ar & boost::serialization::make_nvp("size1", size1);
             ar & boost::serialization::make_nvp("size2", size2);
-            for(std::size_t i=0; i<_locs.size1(); ++i) {
-                for(std::size_t j=0; j<_locs.size2(); ++j) {
-                    ar & boost::serialization::make_nvp("location", _locs(i,j));
+            if(checkpoint::columnar<Archive>::value) {
+                // positions are implied by the order of locations, and only
+                // locations that have meta-data save it:
+                std::vector<unsigned char> has_md(size1*size2);
+                for(std::size_t i=0; i<size1; ++i) {
+                    for(std::size_t j=0; j<size2; ++j) {
+                        has_md[i*size2+j] = !_locs(i,j)._md.empty();
+                    }
+                }
+                ar & boost::serialization::make_nvp("has_metadata", has_md);
+                for(std::size_t i=0; i<size1; ++i) {
+                    for(std::size_t j=0; j<size2; ++j) {
+                        if(has_md[i*size2+j]) {
+                            ar & boost::serialization::make_nvp("metadata", _locs(i,j)._md);
+                        }
+                    }
+                }
+            } else {
+                for(std::size_t i=0; i<_locs.size1(); ++i) {
+                    for(std::size_t j=0; j<_locs.size2(); ++j) {
+                        ar & boost::serialization::make_nvp("location", _locs(i,j));
+                    }
                 }
             }
+            ar & boost::serialization::make_nvp("ldata", _ldata);
 		}
 		
 		template<class Archive>
@@ -491,15 +585,63 @@ namespace ealib {
             ar & boost::serialization::make_nvp("size1", size1);
             ar & boost::serialization::make_nvp("size2", size2);
             _locs.resize(size1,size2);
-            for(std::size_t i=0; i<_locs.size1(); ++i) {
-                for(std::size_t j=0; j<_locs.size2(); ++j) {
-                    ar & boost::serialization::make_nvp("location", _locs(i,j));
+            if(checkpoint::columnar<Archive>::value) {
+                std::vector<unsigned char> has_md;
+                ar & boost::serialization::make_nvp("has_metadata", has_md);
+                for(std::size_t i=0; i<size1; ++i) {
+                    for(std::size_t j=0; j<size2; ++j) {
+                        location_type& l=_locs(i,j);
+                        l.r[0] = i;
+                        l.r[1] = j;
+                        l._md.clear();
+                        if(has_md[i*size2+j]) {
+                            ar & boost::serialization::make_nvp("metadata", l._md);
+                        }
+                    }
+                }
+            } else {
+                for(std::size_t i=0; i<_locs.size1(); ++i) {
+                    for(std::size_t j=0; j<_locs.size2(); ++j) {
+                        ar & boost::serialization::make_nvp("location", _locs(i,j));
+                    }
                 }
             }
+            // typed location data was added in version 1:
+            if(version >= 1) {
+                ar & boost::serialization::make_nvp("ldata", _ldata);
+            } else {
+                // before then, the *_ldata instructions kept their data in the
+                // location's meta-data:
+                _ldata.resize(size1*size2);
+                for(std::size_t i=0; i<_locs.size1(); ++i) {
+                    for(std::size_t j=0; j<_locs.size2(); ++j) {
+                        location_type& l=_locs(i,j);
+                        if(exists<LOCATION_DATA>(l)) {
+                            _ldata.ints().set(location_data::LDATA, size2*i + j, get<LOCATION_DATA>(l));
+                            l._md.erase(LOCATION_DATA::key());
+                        }
+                    }
+                }
+            }
+            index_neighbors();
 		}
 		BOOST_SERIALIZATION_SPLIT_MEMBER();
     };
 
 } // ealib
 
+namespace boost {
+    namespace serialization {
+        
+        //! Serialization version of the environment (see BOOST_CLASS_VERSION).
+        template <typename EA>
+        struct version<ealib::environment<EA> > {
+            typedef mpl::int_<1> type;
+            typedef mpl::integral_c_tag tag;
+            BOOST_STATIC_CONSTANT(int, value = version::type::value);
+        };
+        
+    } // serialization
+} // boost
+
 #endif
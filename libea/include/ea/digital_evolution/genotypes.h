@@ -0,0 +1,284 @@
+/* digital_evolution/genotypes.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_GENOTYPES_H_
+#define _EA_DIGITAL_EVOLUTION_GENOTYPES_H_
+
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/signals2.hpp>
+#include <boost/unordered_set.hpp>
+#include <algorithm>
+#include <vector>
+
+#include <ea/digital_evolution/hardware.h>
+#include <ea/digital_evolution/phenotype.h>
+
+namespace ealib {
+
+    /*! A genotype: one distinct genome, shared by all of the organisms that
+     were born with it.
+
+     Genotypes are reference counted; the organisms of a genotype each hold a
+     pointer to it (via genotype_trait), and the genotype_table that interned it
+     holds one more.  The genome itself is immutable once interned.
+     */
+    template <typename Genome>
+    class genotype {
+    public:
+        typedef Genome genome_type;
+        typedef task_phenotype::mask_type mask_type;
+
+        //! Constructor.
+        genotype(std::size_t id, const genome_type& g, std::size_t h, unsigned long update)
+        : _id(id), _genome(g), _hash(h), _update(update), _total(0), _tasks(0) {
+        }
+
+        //! Returns this genotype's ID, unique within its table.
+        std::size_t id() const { return _id; }
+
+        //! Returns this genotype's genome.
+        const genome_type& genome() const { return _genome; }
+
+        //! Returns the hash of this genotype's genome.
+        std::size_t hash() const { return _hash; }
+
+        //! Returns the update at which this genotype was first seen.
+        unsigned long first_update() const { return _update; }
+
+        //! Returns the number of organisms ever born with this genotype.
+        std::size_t total() const { return _total; }
+
+        //! Returns a mask of the tasks performed by organisms of this genotype.
+        mask_type tasks() const { return _tasks; }
+
+        //! Returns the number of times task t was performed by organisms of this genotype.
+        std::size_t task_count(std::size_t t) const {
+            return (t < _counts.size()) ? _counts[t] : 0;
+        }
+
+        //! Records that an organism of this genotype was born.
+        void born() { ++_total; }
+
+        //! Records that an organism of this genotype performed task t.
+        void performed(std::size_t t) {
+            if(t >= _counts.size()) {
+                _counts.resize(t+1, 0);
+            }
+            ++_counts[t];
+            _tasks |= (static_cast<mask_type>(1) << t);
+        }
+
+    protected:
+        std::size_t _id; //!< ID of this genotype.
+        genome_type _genome; //!< Genome of this genotype.
+        std::size_t _hash; //!< Hash of the genome.
+        unsigned long _update; //!< Update at which this genotype was first seen.
+        std::size_t _total; //!< Number of organisms ever born with this genotype.
+        mask_type _tasks; //!< Tasks performed by organisms of this genotype.
+        std::vector<std::size_t> _counts; //!< Number of times each task was performed.
+    };
+
+
+    /*! Genotype trait; points an organism at its genotype.
+
+     \warning Genotypes are not serializable; a genotype_table rebuilds them
+     from the population when it is constructed.
+     */
+    template <typename T>
+    struct genotype_trait {
+        typedef ealib::genotype<hardware::genome_type> genotype_type;
+        typedef boost::shared_ptr<genotype_type> genotype_ptr_type;
+
+        //! Returns this individual's genotype (null if none).
+        genotype_ptr_type& genotype() { return _genotype; }
+
+        //! Serialize this trait (genotypes are not serializable).
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version) {
+        }
+
+        genotype_ptr_type _genotype; //!< Pointer to this individual's genotype.
+    };
+
+
+    /*! Genotype table, similar to the systematics in Avida.
+
+     The table interns the genome that each organism is born with, so that all
+     organisms born with the same genome share one refcounted genotype record.
+     Per-genotype statistics (abundance, update first seen, and task profile)
+     are maintained incrementally from birth, death, and task events, which
+     allows statistics to be gathered in time proportional to the number of
+     genotypes rather than the number of organisms.
+
+     The abundance of a genotype is the number of organisms that point to it.
+     Dead organisms release their genotype; genotypes with no remaining
+     organisms are extinct, and are dropped from the table at the end of each
+     update.  Organisms that die without a death event (e.g., those that
+     cannot execute any instruction) release their genotype when they are
+     destroyed.
+
+     This requires the genotype_trait in the EA's individual traits.  Since
+     each organism points to a single genotype, an EA should only have one
+     table; use digital_evolution::genotypes() rather than building one.  An
+     organism's memory is its own copy of the genome, since it is written to
+     as soon as the organism allocates room for an offspring; the table's copy
+     is the only one that is shared.
+     */
+    template <typename EA>
+    class genotype_table {
+    public:
+        typedef typename EA::individual_type individual_type;
+        typedef typename EA::genome_type genome_type;
+        typedef typename individual_type::traits_type::genotype_type genotype_type;
+        typedef typename individual_type::traits_type::genotype_ptr_type genotype_ptr_type;
+
+        //! Hash of a genotype's genome.
+        struct genotype_hash {
+            std::size_t operator()(const genotype_ptr_type& g) const { return g->hash(); }
+        };
+
+        //! Compares genotypes, and genotypes to genomes, by genome.
+        struct genotype_equal {
+            bool operator()(const genotype_ptr_type& a, const genotype_ptr_type& b) const {
+                return a->genome() == b->genome();
+            }
+            bool operator()(const genome_type& a, const genotype_ptr_type& b) const {
+                return a == b->genome();
+            }
+        };
+
+        typedef boost::unordered_set<genotype_ptr_type, genotype_hash, genotype_equal> table_type;
+        typedef typename table_type::const_iterator iterator;
+
+        //! Constructor; interns the genomes of all living organisms in ea.
+        genotype_table(EA& ea) : _next(0) {
+            for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
+                if(i->alive()) {
+                    i->traits().genotype() = intern(static_cast<const individual_type&>(*i).repr(), ea);
+                    i->traits().genotype()->born();
+                }
+            }
+            _birth = ea.events().birth.connect(boost::bind(&genotype_table::birth, this, _1, _2, _3));
+            _death = ea.events().death.connect(boost::bind(&genotype_table::death, this, _1, _2));
+            _task = ea.events().task.connect(boost::bind(&genotype_table::task, this, _1, _2, _3));
+            _purge = ea.events().end_of_update.connect(boost::bind(&genotype_table::purge, this, _1));
+        }
+
+        //! Returns the hash of genome g.
+        static std::size_t hash(const genome_type& g) {
+            return boost::hash_range(g.begin(), g.end());
+        }
+
+        /*! Returns the genotype for genome g, adding a new one (first seen at
+         the current update) if g has not been seen.
+         */
+        genotype_ptr_type intern(const genome_type& g, EA& ea) {
+            std::size_t h=hash(g);
+            typename table_type::iterator i=find(g, h);
+            if(i != _table.end()) {
+                return *i;
+            }
+            genotype_ptr_type p(new genotype_type(_next++, g, h, ea.current_update()));
+            _table.insert(p);
+            return p;
+        }
+
+        /*! Returns the number of organisms that point to genotype g, which must
+         be a reference to a pointer held by this table.
+         */
+        static std::size_t abundance(const genotype_ptr_type& g) {
+            return g.use_count() - 1;
+        }
+
+        //! Returns the number of genotypes in this table (including recently extinct ones).
+        std::size_t size() const { return _table.size(); }
+
+        //! Returns a begin iterator over the genotypes in this table.
+        iterator begin() const { return _table.begin(); }
+
+        //! Returns an end iterator over the genotypes in this table.
+        iterator end() const { return _table.end(); }
+
+        //! Returns the most abundant genotype (end() if the table is empty).
+        iterator dominant() const {
+            iterator d=end();
+            for(iterator i=begin(); i!=end(); ++i) {
+                if((d == end()) || (abundance(*i) > abundance(*d))
+                   || ((abundance(*i) == abundance(*d)) && ((*i)->id() < (*d)->id()))) {
+                    d = i;
+                }
+            }
+            return d;
+        }
+
+        //! Drops extinct genotypes from this table.
+        void purge(EA& ea) {
+            for(typename table_type::iterator i=_table.begin(); i!=_table.end(); ) {
+                if(abundance(*i) == 0) {
+                    i = _table.erase(i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+
+    protected:
+        //! Hash function object that returns a precomputed hash.
+        struct hash_of {
+            hash_of(std::size_t h) : _h(h) { }
+            std::size_t operator()(const genome_type&) const { return _h; }
+            std::size_t _h;
+        };
+
+        //! Returns the genotype with genome g and hash h.
+        typename table_type::iterator find(const genome_type& g, std::size_t h) {
+            return _table.find(g, hash_of(h), genotype_equal());
+        }
+
+        //! Called when an offspring is born.
+        void birth(individual_type& offspring, individual_type& parent, EA& ea) {
+            offspring.traits().genotype() = intern(static_cast<const individual_type&>(offspring).repr(), ea);
+            offspring.traits().genotype()->born();
+        }
+
+        //! Called when an organism dies.
+        void death(individual_type& ind, EA& ea) {
+            ind.traits().genotype().reset();
+        }
+
+        //! Called when an organism performs a task.
+        void task(individual_type& ind, typename EA::task_library_type::task_ptr_type t, EA& ea) {
+            if(ind.traits().genotype()) {
+                ind.traits().genotype()->performed(t->id());
+            }
+        }
+
+        std::size_t _next; //!< ID of the next genotype.
+        table_type _table; //!< Interned genotypes.
+        boost::signals2::scoped_connection _birth; //!< Connection to birth events.
+        boost::signals2::scoped_connection _death; //!< Connection to death events.
+        boost::signals2::scoped_connection _task; //!< Connection to task events.
+        boost::signals2::scoped_connection _purge; //!< Connection to end of update events.
+    };
+
+} // ealib
+
+#endif
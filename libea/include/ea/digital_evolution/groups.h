@@ -21,18 +21,99 @@
 #ifndef _EA_DIGITAL_EVOLUTION_GROUPS_H_
 #define _EA_DIGITAL_EVOLUTION_GROUPS_H_
 
+#include <boost/accumulators/accumulators.hpp>
+#include <boost/accumulators/statistics/stats.hpp>
+#include <boost/accumulators/statistics/mean.hpp>
+#include <boost/accumulators/statistics/max.hpp>
+#include <boost/unordered_set.hpp>
 #include <algorithm>
+#include <vector>
 #include <ea/mutation.h>
 #include <ea/metadata.h>
+#include <ea/events.h>
+#include <ea/parallel.h>
 #include <ea/selection/random.h>
 #include <ea/selection/proportionate.h>
 #include <ea/datafile.h>
+#include <ea/generational_models/periodic_competition.h>
 
 
 namespace ealib {
     
+    LIBEA_MD_DECL(REPLACEMENT_RATE_P, "ea.metapopulation.replacement_rate.p", double);
+    
+    /*! This group replication method fills the offspring group with copies of a
+     single mutated individual from the parent group.
+     
+     This works best when groups are assumed to be genetically homogeneous.
+     The offspring group is emptied (and its resources reset) first; a group
+     that is being reused should be reset() before this is called, so that
+     nothing else it had survives.  All randomness is drawn from the offspring
+     group's RNG.
+     */
+    template <typename EA>
+    void germline_replication(typename EA::individual_type& parent, typename EA::individual_type& offspring, EA& ea) {
+        typedef typename EA::individual_type::individual_ptr_type individual_ptr_type;
+        
+        offspring.clear();
+        offspring.resources().reset();
+        if(parent.population().empty()) {
+            return;
+        }
+        
+        // grab a copy of the first individual, and mutate it; the parent may be
+        // replicating into other groups on other threads, so it is only read
+        // through a const reference (the non-const repr() invalidates the
+        // organism's label index):
+        typedef typename EA::individual_type::individual_type organism_type;
+        const typename EA::individual_type::genome_type& r=static_cast<const organism_type&>(*parent.population().front()).repr();
+        individual_ptr_type germ=offspring.make_individual(r.begin(), r.end());
+        mutate(*germ, offspring);
+        
+        // and now fill up the offspring population with copies of the germ:
+        offspring.insert(offspring.end(), germ);
+        for(std::size_t j=1; j<get<POPULATION_SIZE>(offspring); ++j) {
+            offspring.insert(offspring.end(), offspring.make_individual(germ->repr().begin(), germ->repr().end()));
+        }
+    }
+    
+    namespace detail {
+        
+        //! Replicates parent groups into offspring groups, for parallel::for_each_chunk.
+        template <typename EA>
+        struct group_replication_chunk {
+            group_replication_chunk(typename EA::population_type& parents, typename EA::population_type& offspring,
+                                    std::vector<int>& seeds, const metadata& md, EA& ea)
+            : _parents(parents), _offspring(offspring), _seeds(seeds), _md(md), _ea(ea) {
+            }
+            
+            void operator()(std::size_t b, std::size_t e, std::size_t) {
+                for( ; b!=e; ++b) {
+                    _offspring[b]->reset(_md);
+                    _offspring[b]->traits() = typename EA::individual_type::traits_type();
+                    _offspring[b]->reset_rng(_seeds[b]);
+                    germline_replication(*_parents[b], *_offspring[b], _ea);
+                }
+            }
+            
+            typename EA::population_type& _parents;
+            typename EA::population_type& _offspring;
+            std::vector<int>& _seeds;
+            const metadata& _md; //!< Meta-data for offspring groups.
+            EA& _ea;
+        };
+        
+    } // detail
+    
     /*! An event that performs periodic competition among metapopulations, based upon
      some attribute accessor.
+     
+     Survivors and parents are selected on the calling thread.  Each parent
+     then replicates into the group of a subpopulation that did not survive,
+     which is reset and reused rather than built anew; these replications are
+     independent, and run on up to PARALLEL_THREADS threads.  Every offspring
+     group gets its own RNG stream, seeded from the metapopulation's RNG in
+     offspring order, so results do not depend on the number of threads.
      */
     template <typename AttributeAccessor, typename EA>
     struct meta_population_competition : periodic_event<METAPOP_COMPETITION_PERIOD,EA> {
@@ -60,7 +141,7 @@ namespace ealib {
             accumulator_set<double, stats<tag::mean, tag::max> > fit;
             AttributeAccessor acc;
             for(typename EA::iterator i=ea.begin(); i!=ea.end(); ++i) {
-                fit(acc(*i));
+                fit(static_cast<double>(acc(*i,ea)));
             }
             _df.write(ea.current_update()).write(mean(fit)).write(max(fit)).endl();
             
@@ -69,7 +150,7 @@ namespace ealib {
             
             // select individuals for survival:
             typename EA::population_type survivors;
-            select_n<selection::random>(ea.population(), survivors, n, ea);
+            select_n<selection::random< > >(ea.population(), survivors, n, ea);
             
             // how many offspring?
             n = get<METAPOPULATION_SIZE>(ea) - survivors.size();
@@ -78,18 +159,34 @@ namespace ealib {
             typename EA::population_type parents;
             select_n<selection::proportionate<AttributeAccessor> >(survivors, parents, n, ea);
             
-            // now, recombine each parent to produce an offspring (population):
+            // offspring groups start from a copy of the metapopulation's meta-data;
+            // this holds only strings, so that it can be copied on any thread
+            // without sharing attributes with the metapopulation:
+            metadata md;
+            md += ea.md();
+            
+            // offspring reuse the groups that didn't survive:
+            boost::unordered_set<typename EA::individual_type*> alive;
+            for(typename EA::population_type::iterator i=survivors.begin(); i!=survivors.end(); ++i) {
+                alive.insert(i->get());
+            }
             typename EA::population_type offspring;
-            for(typename EA::population_type::iterator i=parents.begin(); i!=parents.end(); ++i) {
-                typename EA::individual_ptr_type p=ea.make_individual();
-                germline_replication(**i, *p, ea);
+            for(typename EA::population_type::iterator i=ea.population().begin();
+                (i!=ea.population().end()) && (offspring.size() < parents.size()); ++i) {
+                if(alive.find(i->get()) == alive.end()) {
+                    offspring.push_back(*i);
+                }
+            }
+            while(offspring.size() < parents.size()) {
+                typename EA::individual_ptr_type p(new typename EA::individual_type(md));
                 offspring.push_back(p);
             }
             
-            // reset the survivors:
-            for(typename EA::population_type::iterator i=survivors.begin(); i!=survivors.end(); ++i) {
-                (*i)->reset();
-            }
+            // now, recombine each parent to produce an offspring (population):
+            std::vector<int> seeds;
+            parallel::seeds(offspring.size(), seeds, ea);
+            detail::group_replication_chunk<EA> rc(parents, offspring, seeds, md, ea);
+            parallel::for_each_chunk(offspring.size(), parallel::threads(ea), rc);
             
             // add the offspring to the list of survivors:
             survivors.insert(survivors.end(), offspring.begin(), offspring.end());
@@ -101,26 +198,6 @@ namespace ealib {
         datafile _df; //!< Datafile produced by meta-population competition.
     };
     
-    
-    /*! This group replication method fills the offspring group with copies of a
-     single mutated individual from the parent group.
-     
-     This works best when groups are assumed to be genetically homogeneous.
-     */
-    template <typename EA>
-    void germline_replication(typename EA::individual_type& parent, typename EA::individual_type& offspring, EA& ea) {
-        // grab a copy of the first individual:
-        typename EA::individual_type::individual_type germ(**parent.population().begin());
-        
-        // mutate it:
-        mutate(germ, offspring);
-        
-        // and now fill up the offspring population with copies of the germ:
-        for(std::size_t j=0; j<get<POPULATION_SIZE>(offspring); ++j) {
-            offspring.append(offspring.make_individual(germ.repr()));
-        }        
-    } 
-    
 } // ea
 
 #endif
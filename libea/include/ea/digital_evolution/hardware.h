@@ -23,9 +23,16 @@
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/deque.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/utility.hpp>
+#include <algorithm>
 #include <deque>
+#include <iterator>
+#include <vector>
 #include <strings.h>
 
+#include <ea/data_structures/bounded_deque.h>
+#include <ea/data_structures/mailbox.h>
 #include <ea/genome_types/circular_genome.h>
 #include <ea/mutation.h>
 
@@ -62,7 +69,8 @@ namespace ealib {
      */
     class hardware {
     public:
-        typedef circular_genome<unsigned int> genome_type;
+        typedef unsigned short opcode_type;
+        typedef circular_genome<opcode_type> genome_type;
         typedef mutation::operators::per_site<mutation::site::uniform_isa> mutation_operator_type;
         
         const static int NOP_A = 0;
@@ -75,6 +83,9 @@ namespace ealib {
         
         const static int NUM_HEADS = 4;
         const static int NUM_REGISTERS = 3;
+        const static int MAX_LABEL_SIZE = 16;
+        const static int MAX_STACK_SIZE = 10;
+        const static int MAX_MSGS_QUEUED = 10;
         
         const static int IP = 0;
         const static int RH = 1;
@@ -89,6 +100,15 @@ namespace ealib {
 //        const static int FX = 5;
         
         
+        //! Label stack; labels longer than MAX_LABEL_SIZE are truncated.
+        typedef bounded_deque<int,MAX_LABEL_SIZE> label_stack;
+        
+        //! Data stack; only the most recent MAX_STACK_SIZE values are kept.
+        typedef bounded_deque<int,MAX_STACK_SIZE> data_stack;
+        
+        //! Message queue; only the most recent MAX_MSGS_QUEUED messages are kept.
+        typedef mailbox<MAX_MSGS_QUEUED> message_queue;
+        
         struct abstract_hardware_trace {
             //! Called immediately upon entry to execute().
             virtual void top_half() { }
@@ -104,39 +124,27 @@ namespace ealib {
         }
         
         //! Constructor.
-        hardware(const genome_type& repr) : _repr(repr) {
+        hardware(const genome_type& repr) {
+            assign(repr);
+            initialize();
+        }
+
+        //! Constructor that builds this hardware from the program [f,l).
+        template <typename ForwardIterator>
+        hardware(ForwardIterator f, ForwardIterator l) {
+            assign(f, l);
             initialize();
         }
 
         //! Copy constructor.
         hardware(const hardware& that) {
-            initialize();
-            _repr = that._repr;
-            std::copy(that._head_position, that._head_position+NUM_HEADS, _head_position);
-            std::copy(that._regfile, that._regfile+NUM_REGISTERS, _regfile);
-            _label_stack = that._label_stack;
-            _age = that._age;
-            _mem_extended = that._mem_extended;
-            _cost = that._cost;
-            _orig_size = that._orig_size;
-            _stack = that._stack;
-            _msgs = that._msgs;
+            copy(that);
         }
         
         //! Assignment operator.
         hardware& operator=(const hardware& that) {
             if(this != &that) {
-                initialize();
-                _repr = that._repr;
-                std::copy(that._head_position, that._head_position+NUM_HEADS, _head_position);
-                std::copy(that._regfile, that._regfile+NUM_REGISTERS, _regfile);
-                _label_stack = that._label_stack;
-                _age = that._age;
-                _mem_extended = that._mem_extended;
-                _cost = that._cost;
-                _orig_size = that._orig_size;
-                _stack = that._stack;
-                _msgs = that._msgs;
+                copy(that);
             }
             return *this;
         }
@@ -151,7 +159,7 @@ namespace ealib {
             bool r = (_repr == that._repr);
             r = r && std::equal(_head_position, _head_position+NUM_HEADS, that._head_position);
             r = r && std::equal(_regfile, _regfile+NUM_REGISTERS, that._regfile);
-            r = r && std::equal(_label_stack.begin(), _label_stack.end(), that._label_stack.begin());
+            r = r && (_label_stack == that._label_stack);
             r = r && (_age == that._age);
             r = r && (_mem_extended == that._mem_extended);
             r = r && (_cost== that._cost);
@@ -160,6 +168,53 @@ namespace ealib {
             return r;
         }
         
+        /*! Copy the state of that hardware into this one.
+         
+         Everything but memory and its label index is stored inline, so copying
+         a hardware only allocates those (once, with room for h_alloc); the
+         label index is copied rather than rebuilt by the first h_search.
+         */
+        void copy(const hardware& that) {
+            assign(that._repr);
+            std::copy(that._head_position, that._head_position+NUM_HEADS, _head_position);
+            std::copy(that._regfile, that._regfile+NUM_REGISTERS, _regfile);
+            _cost = that._cost;
+            _age = that._age;
+            _orig_size = that._orig_size;
+            _mem_extended = that._mem_extended;
+            _label_stack = that._label_stack;
+            _stack = that._stack;
+            _msgs = that._msgs;
+            _label_index_valid = that._label_index_valid;
+            if(_label_index_valid) {
+                _label_run.reserve(_repr.capacity());
+                _next_label.reserve(_repr.capacity());
+                _label_run.assign(that._label_run.begin(), that._label_run.end());
+                _next_label.assign(that._next_label.begin(), that._next_label.end());
+            }
+        }
+        
+        //! Set memory to r, reserving enough room for h_alloc.
+        void assign(const genome_type& r) {
+            assign(r.begin(), r.end());
+        }
+        
+        /*! Set memory to [f,l), reserving enough room for h_alloc; memory that
+         is already large enough is reused.  [f,l) must not be part of this
+         hardware's memory.
+         */
+        template <typename ForwardIterator>
+        void assign(ForwardIterator f, ForwardIterator l) {
+            std::size_t n = static_cast<std::size_t>(std::distance(f,l) * 2.5);
+            if(_repr.capacity() < n) {
+                genome_type t;
+                t.reserve(n);
+                _repr.swap(t);
+            }
+            _repr.assign(f, l);
+            _label_index_valid = false;
+        }
+        
         //! (Re-) Initialize this hardware.
         void initialize() {
             bzero(_head_position, sizeof(int)*NUM_HEADS);
@@ -171,6 +226,7 @@ namespace ealib {
             _orig_size = _repr.size();
             _stack.clear();
             _msgs.clear();
+            _label_index_valid = false;
         }
         
         /*! Step this hardware by n virtual CPU cycles.
@@ -181,21 +237,33 @@ namespace ealib {
          the organism as dead.
          */
         template <typename EA>
-        void execute(std::size_t n, typename EA::individual_ptr_type p, EA& ea) {
-//            if(cb != 0) {
-//                cb->top_half();
-//            }
+        void execute(std::size_t n, const typename EA::individual_ptr_type& p, EA& ea) {
+            typename EA::isa_type& isa=ea.isa();
+
+            // tracing is decided once per call:
+            typename EA::trace_type* trace=ea.trace();
+            if((trace != 0) && !trace->begin(*p, ea)) {
+                trace = 0;
+            }
+            
+            // as is profiling:
+            typename EA::profile_type::counters* prof=0;
+            std::size_t period=0;
+            if(ea.profile() != 0) {
+                prof = &ea.profile()->local(isa.size());
+                period = ea.profile()->sample_period();
+            }
 
             std::size_t attempts=0;
             // while we have cycles to spend and we haven't exhausted our attempts
             // at executing an instruction:
             while((n > 0) && (attempts++ < _repr.size())) {
-                // get a pointer to the function object for the current instruction:
-                typename EA::isa_type::inst_ptr_type inst=ea.isa()[_repr[_head_position[IP]]];
+                // opcode of the current instruction:
+                std::size_t op=_repr[_head_position[IP]];
                 
                 // if cost is zero, we're on a new instruction.  figure out its cost:
                 if(_cost == 0) {
-                    _cost = inst->cost(*this, p, ea);
+                    _cost = isa.cost(op, *this, p, ea);
                 }
                 
                 // if there's now a cost to be paid, we can spend up to min(n,_cost) cycles.
@@ -205,14 +273,21 @@ namespace ealib {
                     n -= spent;
                     _cost -= spent;
                     _age += spent;
+                    if(prof != 0) {
+                        prof->spend(op, spent);
+                    }
                 }
                 
                 // if cost is again 0, everything's been paid and we should execute the instruction:
                 if(_cost == 0) {
-                    (*inst)(*this, p, ea);
-//                    if(cb != 0) {
-//                        cb->instruction_executed(_repr[_head_position[IP]]);
-//                    }
+                    if(trace != 0) {
+                        trace->record(*this, op);
+                    }
+                    if(prof != 0) {
+                        prof->execute(op, period, isa, *this, p, ea);
+                    } else {
+                        isa(op, *this, p, ea);
+                    }
                     
                     // if we spent any cycles on this instruction, clear the label stack:
                     if(spent > 0) {
@@ -286,7 +361,9 @@ namespace ealib {
         
         //! Push a label on the label stack
         void pushLabelStack(int label) { 
-            _label_stack.push_back(label);
+            if(!_label_stack.full()) {
+                _label_stack.push_back(label);
+            }
         }
         
         //! Pop one label off the label stack
@@ -346,17 +423,103 @@ namespace ealib {
             std::deque<int> comp; 
             
             for(std::size_t i=0; i<_label_stack.size(); ++i) {
-                int comp_label = (_label_stack[i] + 1) % NUM_REGISTERS; 
-                comp.push_back(comp_label);
+                comp.push_back(getLabelComplement(i));
             }
             return comp;
         }
         
+        //! Get the complement of label i.
+        int getLabelComplement(std::size_t i) {
+            return (_label_stack[i] + 1) % NUM_REGISTERS;
+        }
+        
+        //! Get the number of labels on the label stack.
+        std::size_t getLabelStackSize() {
+            return _label_stack.size();
+        }
+        
+        //! Get the instruction at position pos.
+        int getInstruction(int pos) const {
+            return static_cast<int>(_repr[pos]);
+        }
+        
+        /*! Set the instruction at position pos; the label index is only
+         invalidated if this changes where the nops are.
+         */
+        void setInstruction(int pos, opcode_type inst) {
+            if(isLabel(_repr[pos]) != isLabel(inst)) {
+                _label_index_valid = false;
+            }
+            _repr[pos] = inst;
+        }
+        
+        //! Returns true if inst can be part of a label.
+        static bool isLabel(opcode_type inst) {
+            return inst < NUM_REGISTERS;
+        }
+        
         /*! Search forward in memory from the IP for label.
          
+         If the label is found, return the distance to it from the IP,
+         otherwise return -1.
+         
+         Labels are made of nops, so this only visits the runs of nops in
+         memory that are long enough to hold the label, via an index that is
+         rebuilt lazily whenever memory changes.
+         */
+        template <typename Label>
+        int findLabel(const Label& label) {
+            const int n = _repr.size();
+            const int L = label.size();
+            if((L == 0) || (L > n)) {
+                return scanLabel(label);
+            }
+            for(int j=0; j<L; ++j) {
+                if(!isLabel(label[j])) {
+                    return scanLabel(label);
+                }
+            }
+            
+            indexLabels();
+            int d = 0;
+            int i = _head_position[IP];
+            while(d < n) {
+                // skip to the next nop:
+                int step = _next_label[i];
+                d += step;
+                if(d >= n) {
+                    break;
+                }
+                i = (i + step) % n;
+                
+                // and check each position in this run of nops that could
+                // hold the label:
+                int run = _label_run[i];
+                if(run == n) {
+                    // memory is all nops; every position can start the label:
+                    run = n + L - 1;
+                }
+                for(int k=0; (k+L <= run) && (d < n); ++k, ++d, i=advance(i)) {
+                    if(matchLabel(label, i)) {
+                        return d;
+                    }
+                }
+                
+                // skip the rest of the run, which is too short to hold the label:
+                int rest = (run >= L) ? (L - 1) : run;
+                d += rest;
+                i = (i + rest) % n;
+            }
+            return -1;
+        }
+        
+        /*! Search forward in memory from the IP for label, comparing the label
+         at every position.
+         
          If the label is found, return the distance to it from the IP,
          otherwise return -1 */
-        int findLabel(const std::deque<int>& label) {
+        template <typename Label>
+        int scanLabel(const Label& label) {
             if (label.size() > 0) {
                 int d = 0; 
                 int i = _head_position[IP];
@@ -365,7 +528,7 @@ namespace ealib {
                     exited = true;
                     for(std::size_t j=0; j<label.size(); ++j) {
                         int k = advance(i, j); 
-                        if(static_cast<int>(_repr[k]) != label[j]) { 
+                        if(static_cast<int>(_repr[k]) != static_cast<int>(label[j])) { 
                             exited = false;
                             break; 
                         } 
@@ -390,7 +553,10 @@ namespace ealib {
         std::pair<int, int> findComplementLabel() {
             std::pair <int, int> retVal;
             if (_label_stack.size() > 0) {
-                std::deque<int> comp = getLabelComplement();
+                label_stack comp;
+                for(std::size_t i=0; i<_label_stack.size(); ++i) {
+                    comp.push_back(getLabelComplement(i));
+                }
                 int dist = findLabel(comp);
                 retVal = std::make_pair(dist, comp.size());
             } else {
@@ -404,28 +570,46 @@ namespace ealib {
             if(!_mem_extended) {
                 _mem_extended = true;
                 _repr.resize(static_cast<std::size_t>(_orig_size * 2.5), NOP_X);
+                _label_index_valid = false;
             }
         }
         
-        //! Retrieve this hardware's representation.
-        genome_type& repr() { return _repr; }
+        //! Resize memory to n instructions (e.g., when dividing).
+        void resize(std::size_t n) {
+            _repr.resize(n);
+            _label_index_valid = false;
+        }
+        
+        /*! Retrieve this hardware's representation.
+         
+         Memory may be changed through the returned reference, so this
+         invalidates the label index; use the const-qualified version, or
+         getInstruction() and setInstruction(), where possible.
+         */
+        genome_type& repr() {
+            _label_index_valid = false;
+            return _repr;
+        }
 
         //! Retrieve this hardware's representation (const-qualified).
         const genome_type& repr() const { return _repr; }
 
-        void push_stack(int x) { _stack.push_front(x); while(_stack.size() > 10) { _stack.pop_back(); } }
+        void push_stack(int x) { if(_stack.full()) { _stack.pop_back(); } _stack.push_front(x); }
         bool empty_stack() { return _stack.empty(); }
         int pop_stack() { int x = _stack.front(); _stack.pop_front(); return x; }
         
+        /*! Deposit a message into this hardware's message queue, dropping the
+         oldest message if it is full.  This may be called by any number of
+         threads at once.
+         */
         void deposit_message(int label, int data) {
-            if(_msgs.size() < 10) {
-                _msgs.push_back(std::make_pair(label,data));
-            }
-        };
+            _msgs.push(std::make_pair(label,data));
+        }
         
         std::size_t msgs_queued() { return _msgs.size(); }
         
-        std::pair<int,int> pop_msg() { std::pair<int,int> msg=_msgs.front(); _msgs.pop_front(); return msg; }
+        //! Remove the oldest message into msg, returning false if there is none.
+        bool pop_msg(std::pair<int,int>& msg) { return _msgs.pop(msg); }
         
         std::size_t original_size() { return _orig_size; }
         
@@ -442,33 +626,149 @@ namespace ealib {
     protected:
 //        typename hardware_type::abstract_hardware_trace* _tracecb; //!< Trace handler, if so configured.
 
-        genome_type _repr; //!< This hardware's "program".
+        //! Returns true if label matches memory starting at position i.
+        template <typename Label>
+        bool matchLabel(const Label& label, int i) {
+            for(std::size_t j=0; j<label.size(); ++j, i=advance(i)) {
+                if(static_cast<int>(_repr[i]) != static_cast<int>(label[j])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        
+        /*! (Re-)build the label index, if needed.
+         
+         For each position i in (circular) memory, _label_run[i] is the number
+         of consecutive nops starting at i, and _next_label[i] is the distance
+         from i to the next nop; both are capped at the size of memory.
+         
+         Everything that changes memory invalidates the index (writes that
+         don't change where the nops are, which is the common case for h_copy,
+         leave it as is).  The index has room for all of memory's capacity, so
+         that rebuilding it after h_alloc, or after this hardware is reused for
+         a new organism, doesn't allocate.
+         */
+        void indexLabels() {
+            if(_label_index_valid) {
+                return;
+            }
+            const int n = _repr.size();
+            _label_run.reserve(_repr.capacity());
+            _next_label.reserve(_repr.capacity());
+            _label_run.resize(n);
+            _next_label.resize(n);
+            int run=0, next=n;
+            // two passes backwards around memory, so that runs can wrap:
+            for(int k=2*n-1; k>=0; --k) {
+                int i = k % n;
+                if(isLabel(_repr[i])) {
+                    run = std::min(run+1, n);
+                    next = 0;
+                } else {
+                    run = 0;
+                    next = std::min(next+1, n);
+                }
+                _label_run[i] = run;
+                _next_label[i] = next;
+            }
+            _label_index_valid = true;
+        }
+        
+        // heads, registers and counters are kept together, as they're touched
+        // by nearly every instruction:
         int _head_position[NUM_HEADS]; //!< Positions of the various heads.
         int _regfile[NUM_REGISTERS]; //!< ...
-        
-        std::deque<int> _label_stack;
-        int _age;
-        bool _mem_extended;
         std::size_t _cost;
+        int _age;
         std::size_t _orig_size;
-        std::deque<int> _stack;
-        std::deque<std::pair<int,int> > _msgs;
+        bool _mem_extended;
+        
+        genome_type _repr; //!< This hardware's "program".
+        label_stack _label_stack;
+        data_stack _stack;
+        message_queue _msgs;
+        bool _label_index_valid; //!< True if the label index describes memory.
+        std::vector<int> _label_run; //!< Length of the run of nops starting at each position.
+        std::vector<int> _next_label; //!< Distance to the next nop from each position.
         
     private:
+        /*! Save a bounded_deque as a std::deque, which is how these were
+         stored before they were made inline.
+         */
+        template <class Archive, typename T, std::size_t N>
+        void save_deque(Archive& ar, const char* name, const bounded_deque<T,N>& d) const {
+            std::deque<T> t;
+            for(std::size_t i=0; i<d.size(); ++i) {
+                t.push_back(d[i]);
+            }
+            ar & boost::serialization::make_nvp(name, t);
+        }
+        
+        //! Load a bounded_deque saved by save_deque.
+        template <class Archive, typename T, std::size_t N>
+        void load_deque(Archive& ar, const char* name, bounded_deque<T,N>& d) {
+            std::deque<T> t;
+            ar & boost::serialization::make_nvp(name, t);
+            d.clear();
+            for(typename std::deque<T>::iterator i=t.begin(); (i!=t.end()) && !d.full(); ++i) {
+                d.push_back(*i);
+            }
+        }
+        
+        /*! Save a mailbox as a std::deque, as with save_deque.
+         
+         Only a snapshot is read, so the mailbox is not modified while it is
+         being saved.
+         */
+        template <class Archive, std::size_t N>
+        void save_mailbox(Archive& ar, const char* name, const mailbox<N>& m) const {
+            std::pair<int,int> r[N];
+            std::deque<std::pair<int,int> > t(r, r+m.snapshot(r));
+            ar & boost::serialization::make_nvp(name, t);
+        }
+        
+        //! Load a mailbox saved by save_mailbox.
+        template <class Archive, std::size_t N>
+        void load_mailbox(Archive& ar, const char* name, mailbox<N>& m) {
+            std::deque<std::pair<int,int> > t;
+            ar & boost::serialization::make_nvp(name, t);
+            m.clear();
+            for(std::deque<std::pair<int,int> >::iterator i=t.begin(); i!=t.end(); ++i) {
+                m.push(*i);
+            }
+        }
+        
         friend class boost::serialization::access;
         template <class Archive>
-        void serialize(Archive& ar, const unsigned int version) {
+        void save(Archive& ar, const unsigned int version) const {
+            ar & boost::serialization::make_nvp("representation", _repr);
+            ar & boost::serialization::make_nvp("head_positions", _head_position);
+            ar & boost::serialization::make_nvp("register_file", _regfile);
+            save_deque(ar, "labels", _label_stack);
+            ar & boost::serialization::make_nvp("age", _age);
+            ar & boost::serialization::make_nvp("extended", _mem_extended);
+            ar & boost::serialization::make_nvp("cost", _cost);
+            ar & boost::serialization::make_nvp("original_size", _orig_size);
+            save_deque(ar, "stack", _stack);
+            save_mailbox(ar, "messages", _msgs);
+        }
+        
+        template <class Archive>
+        void load(Archive& ar, const unsigned int version) {
             ar & boost::serialization::make_nvp("representation", _repr);
             ar & boost::serialization::make_nvp("head_positions", _head_position);
             ar & boost::serialization::make_nvp("register_file", _regfile);
-            ar & boost::serialization::make_nvp("labels", _label_stack);
+            load_deque(ar, "labels", _label_stack);
+            _label_index_valid = false;
             ar & boost::serialization::make_nvp("age", _age);
             ar & boost::serialization::make_nvp("extended", _mem_extended);
             ar & boost::serialization::make_nvp("cost", _cost);
             ar & boost::serialization::make_nvp("original_size", _orig_size);
-            ar & boost::serialization::make_nvp("stack", _stack);
-            ar & boost::serialization::make_nvp("messages", _msgs);
+            load_deque(ar, "stack", _stack);
+            load_mailbox(ar, "messages", _msgs);
         }
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
     };
     
 } // ea
@@ -0,0 +1,176 @@
+/* digital_evolution/instruction_profile.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_INSTRUCTION_PROFILE_H_
+#define _EA_DIGITAL_EVOLUTION_INSTRUCTION_PROFILE_H_
+
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace ealib {
+
+    /*! Per-opcode execution counts, virtual cycles, and (sampled) wall time.
+
+     While a profile is attached to an EA (see digital_evolution::profile()),
+     the hardware charges every cycle it spends and every instruction it
+     executes to the instruction's opcode.  Only one of every sample_period()
+     executions is timed, and its time is scaled up by the sample period, so
+     that reading the clock does not dominate the profile.
+
+     Counts are kept per thread, so that profiling needs no locks while
+     organisms run, even with a multi-threaded scheduler.  collect() sums and
+     resets them, and must only be called while no organism is executing.
+     */
+    template <typename EA>
+    class instruction_profile {
+    public:
+        typedef boost::chrono::high_resolution_clock clock_type;
+
+        //! Default number of executions per timed execution.
+        const static std::size_t SAMPLE_PERIOD=64;
+
+        //! Counts for one thread (or the sum over all threads).
+        struct counters {
+            //! Constructor.
+            counters() : tick(0), owner(0) {
+            }
+
+            //! Resizes these counters to n opcodes.
+            void resize(std::size_t n) {
+                executed.resize(n, 0);
+                cycles.resize(n, 0);
+                seconds.resize(n, 0.0);
+            }
+
+            //! Resets these counters to zero.
+            void clear() {
+                std::fill(executed.begin(), executed.end(), 0);
+                std::fill(cycles.begin(), cycles.end(), 0);
+                std::fill(seconds.begin(), seconds.end(), 0.0);
+            }
+
+            //! Charges n cycles to opcode op.
+            void spend(std::size_t op, std::size_t n) {
+                cycles[op] += n;
+            }
+
+            //! Executes opcode op via isa, counting (and possibly timing) it.
+            template <typename ISA, typename Hardware, typename IndividualPtr>
+            void execute(std::size_t op, std::size_t period, ISA& isa, Hardware& hw, const IndividualPtr& p, EA& ea) {
+                ++executed[op];
+                if(++tick < period) {
+                    isa(op, hw, p, ea);
+                    return;
+                }
+                tick = 0;
+                clock_type::time_point t0=clock_type::now();
+                isa(op, hw, p, ea);
+                boost::chrono::duration<double> d=clock_type::now() - t0;
+                seconds[op] += d.count() * period;
+            }
+
+            std::vector<unsigned long> executed; //!< Number of executions of each opcode.
+            std::vector<unsigned long> cycles; //!< Virtual cycles spent on each opcode.
+            std::vector<double> seconds; //!< Estimated wall time spent in each opcode.
+            std::size_t tick; //!< Executions since the last timed execution.
+            instruction_profile* owner; //!< Profile that owns these counters.
+        };
+
+        //! Constructor; attaches this profile to ea.
+        instruction_profile(EA& ea, std::size_t period=SAMPLE_PERIOD)
+        : _ea(ea), _period(period), _tls(&instruction_profile::retire) {
+            _ea.profile(this);
+        }
+
+        //! Destructor; detaches this profile.
+        virtual ~instruction_profile() {
+            _ea.profile(0);
+            _tls.release();
+            for(typename std::vector<counters*>::iterator i=_threads.begin(); i!=_threads.end(); ++i) {
+                delete *i;
+            }
+        }
+
+        //! Returns the number of executions per timed execution.
+        std::size_t sample_period() const { return _period; }
+
+        /*! Returns the calling thread's counters, sized for n opcodes; called by
+         the hardware on entry to execute().
+         */
+        counters& local(std::size_t n) {
+            counters* c=_tls.get();
+            if(c == 0) {
+                boost::mutex::scoped_lock lock(_mutex);
+                if(_idle.empty()) {
+                    c = new counters();
+                    c->owner = this;
+                    _threads.push_back(c);
+                } else {
+                    c = _idle.back();
+                    _idle.pop_back();
+                }
+                _tls.reset(c);
+            }
+            if(c->executed.size() < n) {
+                c->resize(n);
+            }
+            return *c;
+        }
+
+        //! Returns the counts summed over all threads since the last call, and resets them.
+        counters collect() {
+            counters r;
+            r.resize(_ea.isa().size());
+            boost::mutex::scoped_lock lock(_mutex);
+            for(typename std::vector<counters*>::iterator i=_threads.begin(); i!=_threads.end(); ++i) {
+                counters& c=**i;
+                for(std::size_t j=0; j<c.executed.size(); ++j) {
+                    r.executed[j] += c.executed[j];
+                    r.cycles[j] += c.cycles[j];
+                    r.seconds[j] += c.seconds[j];
+                }
+                c.clear();
+            }
+            return r;
+        }
+
+    protected:
+        /*! Called when a thread that has executed exits; its counters are kept
+         (and reused by later threads), since schedulers may start new threads
+         every update.
+         */
+        static void retire(counters* c) {
+            boost::mutex::scoped_lock lock(c->owner->_mutex);
+            c->owner->_idle.push_back(c);
+        }
+
+        EA& _ea; //!< EA being profiled.
+        std::size_t _period; //!< Executions per timed execution.
+        boost::mutex _mutex; //!< Guards the list of counters.
+        std::vector<counters*> _threads; //!< Counters of every thread that has executed.
+        std::vector<counters*> _idle; //!< Counters of threads that have exited.
+        boost::thread_specific_ptr<counters> _tls; //!< Counters of the calling thread.
+    };
+
+} // ealib
+
+#endif
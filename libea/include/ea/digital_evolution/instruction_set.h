@@ -34,8 +34,8 @@ template <typename Hardware, typename EA> \
 struct name : ealib::instructions::abstract_instruction<Hardware,EA> { \
 name(std::size_t cost) : ealib::instructions::abstract_instruction<Hardware,EA>(#name,cost) { } \
 virtual ~name() { } \
-virtual void operator()(Hardware& hw, typename EA::individual_ptr_type p, EA& ea); }; \
-template<typename Hardware,typename EA> void name<Hardware,EA>::operator()(Hardware& hw, typename EA::individual_ptr_type p, EA& ea)
+virtual void operator()(Hardware& hw, const typename EA::individual_ptr_type& p, EA& ea); }; \
+template<typename Hardware,typename EA> void name<Hardware,EA>::operator()(Hardware& hw, const typename EA::individual_ptr_type& p, EA& ea)
 
 
 namespace ealib {
@@ -54,12 +54,12 @@ namespace ealib {
             virtual const std::string& name() { return _name; }
             
             //! Return the cost of this instruction in cycles.
-            virtual std::size_t cost(Hardware& hw, typename EA::individual_ptr_type p, EA& ea) {
+            virtual std::size_t cost(Hardware& hw, const typename EA::individual_ptr_type& p, EA& ea) {
                 return _cost;
             }
 
             //! Execute this instruction.
-            virtual void operator()(Hardware& hw, typename EA::individual_ptr_type p, EA& ea) = 0;
+            virtual void operator()(Hardware& hw, const typename EA::individual_ptr_type& p, EA& ea) = 0;
             
             std::string _name; //!< Name of this instruction.
             std::size_t _cost; //!< Cost of executing this instruction.
@@ -119,8 +119,7 @@ namespace ealib {
          each advanced one instruction.
          */
         DIGEVO_INSTRUCTION_DECL(h_copy) {
-            typename Hardware::genome_type& r = hw.repr();
-            r[hw.getHeadLocation(Hardware::WH)] = r[hw.getHeadLocation(Hardware::RH)];
+            hw.setInstruction(hw.getHeadLocation(Hardware::WH), hw.getInstruction(hw.getHeadLocation(Hardware::RH)));
             hw.advanceHead(Hardware::WH);
             hw.advanceHead(Hardware::RH);
         }
@@ -145,11 +144,10 @@ namespace ealib {
             if(!hw.isLabelStackEmpty()) {
                 // what immediately preceeds the write head...
                 int wh = hw.advance(hw.getHeadLocation(Hardware::WH), -1);
-                std::deque<int> label_comp = hw.getLabelComplement();
                 // check through label in reverse order...
                 // most recent label is on the back...
-                for(int i=(label_comp.size() - 1);  i>=0; --i) { 
-                    if(label_comp[i] != static_cast<int>(hw.repr()[wh])) {
+                for(int i=(hw.getLabelStackSize() - 1);  i>=0; --i) { 
+                    if(hw.getLabelComplement(i) != hw.getInstruction(wh)) {
                         hw.advanceHead(Hardware::IP);
                         return;
                     }
@@ -218,11 +216,10 @@ namespace ealib {
                 typename Hardware::genome_type::iterator f=r.begin(),l=r.begin();
                 std::advance(f, hw.getHeadLocation(Hardware::RH));
                 std::advance(l, hw.getHeadLocation(Hardware::WH));                             
-                typename Hardware::genome_type offr(f, l);
+                typename EA::individual_ptr_type o=ea.make_individual(f, l);
                 
-                
-                r.resize(parent_size);
-                replicate(p, offr, ea);
+                hw.resize(parent_size);
+                replicate(p, o, ea);
                 hw.replicated();
             }
         }
@@ -251,7 +248,7 @@ namespace ealib {
                     return;
                 }
                 
-                r.resize(parent_size);
+                hw.resize(parent_size);
                 hw.replicated();
             }
         }
@@ -289,11 +286,10 @@ namespace ealib {
                 typename Hardware::genome_type::iterator f=r.begin(),l=r.begin();
                 std::advance(f, hw.getHeadLocation(Hardware::RH));
                 std::advance(l, hw.getHeadLocation(Hardware::WH));
-                typename Hardware::genome_type offr(f, l);
-                
+                typename EA::individual_ptr_type o=ea.make_individual(f, l);
                 
-                r.resize(parent_size);
-                replicate(p, offr, ea);
+                hw.resize(parent_size);
+                replicate(p, o, ea);
                 hw.replicated_soft_reset();
                 
             }
@@ -392,29 +388,31 @@ namespace ealib {
         //! Latch the data contents of the organism's location.
         DIGEVO_INSTRUCTION_DECL(latch_ldata) {
             int bxVal = hw.getRegValue(hw.modifyRegister());
-            if(!exists<LOCATION_DATA>(*p->location())) {
-                put<LOCATION_DATA>(bxVal,*p->location());
-            }
+            ea.env().ldata().ints().latch(location_data::LDATA, ea.env().index(p->position()), bxVal);
         }
 
         //! Set the data contents of the organism's location.
         DIGEVO_INSTRUCTION_DECL(set_ldata) {
             int bxVal = hw.getRegValue(hw.modifyRegister());
-            put<LOCATION_DATA>(bxVal,*p->location());
+            ea.env().ldata().ints().set(location_data::LDATA, ea.env().index(p->position()), bxVal);
         }
 
         //! Get the data contents of the organism's location, if it exists.
         DIGEVO_INSTRUCTION_DECL(get_ldata) {
-            if(exists<LOCATION_DATA>(*p->location())) {
-                hw.setRegValue(hw.modifyRegister(), get<LOCATION_DATA>(*p->location()));
+            location_fields<int>& ld=ea.env().ldata().ints();
+            std::size_t i=ea.env().index(p->position());
+            if(ld.exists(location_data::LDATA, i)) {
+                hw.setRegValue(hw.modifyRegister(), ld.get(location_data::LDATA, i));
             }
         }
 
         //! Get the data contents of a neighboring location, if it exists.
         DIGEVO_INSTRUCTION_DECL(get_neighbor_ldata) {
-            typename EA::environment_type::location_type& l=*ea.env().neighbor(p,ea);            
-            if(exists<LOCATION_DATA>(l)) {
-                hw.setRegValue(hw.modifyRegister(), get<LOCATION_DATA>(l));
+            location_fields<int>& ld=ea.env().ldata().ints();
+            const position_type& pos=p->position();
+            std::size_t i=ea.env().neighbor_index(ea.env().index(pos), pos.heading());
+            if(ld.exists(location_data::LDATA, i)) {
+                hw.setRegValue(hw.modifyRegister(), ld.get(location_data::LDATA, i));
             }
         }
         
@@ -491,8 +489,8 @@ namespace ealib {
         
         //! Retrieve a message from the caller's message buffer.
         DIGEVO_INSTRUCTION_DECL(rx_msg) {
-            if(hw.msgs_queued()) {
-                std::pair<int,int> msg = hw.pop_msg();
+            std::pair<int,int> msg;
+            if(hw.pop_msg(msg)) {
                 int rbx = hw.modifyRegister();
                 int rcx = hw.nextRegister(rbx);
                 hw.setRegValue(rbx,msg.first);
@@ -500,34 +498,33 @@ namespace ealib {
             }
         }
         
-        //! Broadcast a message.
-        DIGEVO_INSTRUCTION_DECL(bc_msg) {
-            int rbx = hw.modifyRegister();
-            int rcx = hw.nextRegister(rbx);
-            
+        /*! Deposit a message with each occupied neighbor of p, found via the
+         environment's neighbor table.
+         */
+        template <typename EA>
+        void broadcast_message(int label, int data, const typename EA::individual_ptr_type& p, EA& ea) {
             typedef typename EA::environment_type::neighborhood_iterator neighborhood_iterator;
             std::pair<neighborhood_iterator,neighborhood_iterator> ni=ea.env().neighborhood(*p);
             for(; ni.first!=ni.second; ++ni.first) {
                 typename EA::environment_type::location_type& l=*ni.first;
                 if(l.occupied()) {
-                    l.inhabitant()->hw().deposit_message(hw.getRegValue(rbx), hw.getRegValue(rcx));
+                    l.inhabitant()->hw().deposit_message(label, data);
                 }
             }
         }
+        
+        //! Broadcast a message.
+        DIGEVO_INSTRUCTION_DECL(bc_msg) {
+            int rbx = hw.modifyRegister();
+            int rcx = hw.nextRegister(rbx);
+            broadcast_message(hw.getRegValue(rbx), hw.getRegValue(rcx), p, ea);
+        }
             
         //! Broadcast a message.
         DIGEVO_INSTRUCTION_DECL(bc_msg_check_task) {
             int rbx = hw.modifyRegister();
             int rcx = hw.nextRegister(rbx);
-            
-            typedef typename EA::environment_type::neighborhood_iterator neighborhood_iterator;
-            std::pair<neighborhood_iterator,neighborhood_iterator> ni=ea.env().neighborhood(*p);
-            for(; ni.first!=ni.second; ++ni.first) {
-                typename EA::environment_type::location_type& l=*ni.first;
-                if(l.occupied()) {
-                    l.inhabitant()->hw().deposit_message(hw.getRegValue(rbx), hw.getRegValue(rcx));
-                }
-            }
+            broadcast_message(hw.getRegValue(rbx), hw.getRegValue(rcx), p, ea);
             
             p->outputs().push_front(hw.getRegValue(hw.modifyRegister()));
             p->outputs().resize(1);
@@ -635,6 +632,13 @@ namespace ealib {
 
 
     /*! Instruction set architecture for digital evolution.
+     
+     Instructions are owned as abstract_instruction objects (for names and
+     knockouts), but are executed through a dense dispatch table that is built
+     as instructions are appended.  Each entry holds a plain function pointer
+     that calls the concrete instruction type directly (not through its
+     vtable), and the instruction's cost, which is cached unless the
+     instruction overrides cost().
      */
     template <typename EA>
     class instruction_set {
@@ -649,6 +653,18 @@ namespace ealib {
         
         typedef std::map<std::string, std::size_t> name_map_type;
         
+        //! Type of a compiled instruction.
+        typedef void (*exec_type)(inst_type*, hardware_type&, const individual_ptr_type&, ea_type&);
+        
+        //! Entry in the dispatch table.
+        struct dispatch_entry {
+            inst_type* inst; //!< Instruction.
+            exec_type exec; //!< Compiled instruction.
+            std::size_t cost; //!< Cached cost, if fixed.
+            bool fixed_cost; //!< True if cost is fixed.
+        };
+        typedef std::vector<dispatch_entry> dispatch_table_type;
+        
         //! Constructor.
         instruction_set() {
         }
@@ -658,6 +674,7 @@ namespace ealib {
         void append(std::size_t cost) {
             boost::shared_ptr<inst_type> p(new Instruction<hardware_type,ea_type>(cost));
             _isa.push_back(p);
+            _dispatch.push_back(compile<Instruction>(p.get()));
             _name[p->name()] = _isa.size() - 1;
         }
         
@@ -668,11 +685,19 @@ namespace ealib {
             std::size_t i=operator[](k.name());
             boost::shared_ptr<inst_type> p(new Replacement<hardware_type,ea_type>(cost));
             _isa[i] = p;
+            _dispatch[i] = compile<Replacement>(p.get());
         }
         
         //! Execute instruction i.
-        void operator()(std::size_t i, hardware_type& hw, individual_ptr_type p, ea_type& ea) {
-            (*_isa[i])(hw,p,ea);
+        void operator()(std::size_t i, hardware_type& hw, const individual_ptr_type& p, ea_type& ea) {
+            const dispatch_entry& d=_dispatch[i];
+            d.exec(d.inst, hw, p, ea);
+        }
+        
+        //! Returns the cost of instruction i.
+        std::size_t cost(std::size_t i, hardware_type& hw, const individual_ptr_type& p, ea_type& ea) {
+            const dispatch_entry& d=_dispatch[i];
+            return d.fixed_cost ? d.cost : d.inst->cost(hw, p, ea);
         }
         
         //! Retrieve a pointer to instruction i.
@@ -694,7 +719,37 @@ namespace ealib {
         std::size_t size() const { return _isa.size(); }
         
     protected:
+        //! Calls Instruction directly, bypassing its vtable.
+        template <template <typename,typename> class Instruction>
+        static void exec(inst_type* inst, hardware_type& hw, const individual_ptr_type& p, ea_type& ea) {
+            typedef Instruction<hardware_type,ea_type> instruction_type;
+            static_cast<instruction_type*>(inst)->instruction_type::operator()(hw, p, ea);
+        }
+        
+        //! Instructions that do not override cost() have a fixed cost.
+        static bool fixed_cost(std::size_t (inst_type::*)(hardware_type&, const individual_ptr_type&, ea_type&)) {
+            return true;
+        }
+        
+        //! Instructions that override cost() have a dynamic cost.
+        template <typename MemberFunction>
+        static bool fixed_cost(MemberFunction) {
+            return false;
+        }
+        
+        //! Build the dispatch table entry for the given instruction.
+        template <template <typename,typename> class Instruction>
+        dispatch_entry compile(inst_type* inst) {
+            dispatch_entry d;
+            d.inst = inst;
+            d.exec = &instruction_set::template exec<Instruction>;
+            d.cost = inst->_cost;
+            d.fixed_cost = fixed_cost(&Instruction<hardware_type,ea_type>::cost);
+            return d;
+        }
+        
         isa_type _isa; //!< List of available instructions.
+        dispatch_table_type _dispatch; //!< Dispatch table, indexed by opcode.
         name_map_type _name; //<! Map of human-readable instruction names to their index in the ISA.
         
     private:
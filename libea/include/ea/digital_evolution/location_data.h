@@ -0,0 +1,230 @@
+/* digital_evolution/location_data.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_LOCATION_DATA_H_
+#define _EA_DIGITAL_EVOLUTION_LOCATION_DATA_H_
+
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include <ea/exceptions.h>
+#include <ea/metadata.h>
+
+namespace ealib {
+
+    /*! Fields of type T that hold one value per location.
+
+     Each field is a dense array indexed by location, together with a flag per
+     location that records whether a value has been set there.  Fields are
+     registered by name, and thereafter referred to by index.
+     */
+    template <typename T>
+    class location_fields {
+    public:
+        typedef T value_type;
+
+        //! Constructor.
+        location_fields() : _n(0) {
+        }
+
+        //! Returns true if both hold the same fields and values.
+        bool operator==(const location_fields& that) const {
+            return (_n == that._n) && (_names == that._names)
+            && (_values == that._values) && (_set == that._set);
+        }
+
+        /*! Registers a field with the given name, and returns its index.  If
+         the field is already registered, its index is returned.
+         */
+        std::size_t add(const std::string& name) {
+            std::vector<std::string>::iterator i=std::find(_names.begin(), _names.end(), name);
+            if(i != _names.end()) {
+                return i - _names.begin();
+            }
+            _names.push_back(name);
+            _values.resize(_names.size()*_n, T());
+            _set.resize(_names.size()*_n, 0);
+            return _names.size()-1;
+        }
+
+        //! Returns the index of the field with the given name.
+        std::size_t find(const std::string& name) const {
+            std::vector<std::string>::const_iterator i=std::find(_names.begin(), _names.end(), name);
+            if(i == _names.end()) {
+                throw fatal_error_exception("location_fields: could not find field " + name);
+            }
+            return i - _names.begin();
+        }
+
+        //! Returns the number of fields.
+        std::size_t size() const {
+            return _names.size();
+        }
+
+        //! Resizes all fields to n locations, unsetting all values.
+        void resize(std::size_t n) {
+            _n = n;
+            _values.assign(_names.size()*_n, T());
+            _set.assign(_names.size()*_n, 0);
+        }
+
+        //! Unsets all values of all fields.
+        void reset() {
+            std::fill(_values.begin(), _values.end(), T());
+            std::fill(_set.begin(), _set.end(), 0);
+        }
+
+        //! Returns true if field f has been set at location i.
+        bool exists(std::size_t f, std::size_t i) const {
+            return _set[slot(f,i)] != 0;
+        }
+
+        //! Returns the value of field f at location i (T() if unset).
+        T get(std::size_t f, std::size_t i) const {
+            return _values[slot(f,i)];
+        }
+
+        //! Sets the value of field f at location i.
+        void set(std::size_t f, std::size_t i, T v) {
+            std::size_t j=slot(f,i);
+            _values[j] = v;
+            _set[j] = 1;
+        }
+
+        //! Sets the value of field f at location i, only if it is not already set.
+        void latch(std::size_t f, std::size_t i, T v) {
+            std::size_t j=slot(f,i);
+            if(!_set[j]) {
+                _values[j] = v;
+                _set[j] = 1;
+            }
+        }
+
+    protected:
+        //! Returns the array index of field f at location i.
+        std::size_t slot(std::size_t f, std::size_t i) const {
+            assert((f < _names.size()) && (i < _n));
+            return f*_n + i;
+        }
+
+        std::size_t _n; //!< Number of locations.
+        std::vector<std::string> _names; //!< Name of each field.
+        std::vector<T> _values; //!< Values, field-major.
+        std::vector<unsigned char> _set; //!< Whether each value has been set.
+
+    private:
+        friend class boost::serialization::access;
+        template <class Archive>
+        void save(Archive& ar, const unsigned int version) const {
+            // only values that have been set are saved:
+            std::vector<std::size_t> slots;
+            std::vector<T> values;
+            for(std::size_t j=0; j<_set.size(); ++j) {
+                if(_set[j]) {
+                    slots.push_back(j);
+                    values.push_back(_values[j]);
+                }
+            }
+            ar & boost::serialization::make_nvp("n", _n);
+            ar & boost::serialization::make_nvp("names", _names);
+            ar & boost::serialization::make_nvp("slots", slots);
+            ar & boost::serialization::make_nvp("values", values);
+        }
+
+        template <class Archive>
+        void load(Archive& ar, const unsigned int version) {
+            std::vector<std::size_t> slots;
+            std::vector<T> values;
+            ar & boost::serialization::make_nvp("n", _n);
+            ar & boost::serialization::make_nvp("names", _names);
+            ar & boost::serialization::make_nvp("slots", slots);
+            ar & boost::serialization::make_nvp("values", values);
+            resize(_n);
+            for(std::size_t j=0; j<slots.size(); ++j) {
+                _values[slots[j]] = values[j];
+                _set[slots[j]] = 1;
+            }
+        }
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+    };
+
+
+    /*! Typed data attached to every location in an environment (e.g., for
+     stigmergy).
+
+     This is a faster alternative to location meta-data: values are held in
+     dense arrays of int and double fields, and are accessed by field and
+     location index in constant time.  Fields are typically registered from a
+     lifecycle's after_initialization(); int field 0 always exists, and is the
+     one used by the *_ldata instructions.
+     */
+    class location_data {
+    public:
+        //! Index of the int field used by the *_ldata instructions.
+        const static std::size_t LDATA=0;
+
+        //! Constructor.
+        location_data() {
+            _ints.add(LOCATION_DATA::key());
+        }
+
+        //! Returns true if both hold the same fields and values.
+        bool operator==(const location_data& that) const {
+            return (_ints == that._ints) && (_doubles == that._doubles);
+        }
+
+        //! Returns the int fields.
+        location_fields<int>& ints() { return _ints; }
+
+        //! Returns the double fields.
+        location_fields<double>& doubles() { return _doubles; }
+
+        //! Resizes all fields to n locations, unsetting all values.
+        void resize(std::size_t n) {
+            _ints.resize(n);
+            _doubles.resize(n);
+        }
+
+        //! Unsets all values of all fields.
+        void reset() {
+            _ints.reset();
+            _doubles.reset();
+        }
+
+    protected:
+        location_fields<int> _ints; //!< Int fields.
+        location_fields<double> _doubles; //!< Double fields.
+
+    private:
+        friend class boost::serialization::access;
+        template <class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & boost::serialization::make_nvp("ints", _ints);
+            ar & boost::serialization::make_nvp("doubles", _doubles);
+        }
+    };
+
+} // ealib
+
+#endif
@@ -33,6 +33,7 @@
 
 #include <ea/digital_evolution/environment.h>
 #include <ea/digital_evolution/hardware.h>
+#include <ea/digital_evolution/phenotype.h>
 #include <ea/digital_evolution/schedulers.h>
 #include <ea/metadata.h>
 
@@ -50,7 +51,7 @@ namespace ealib {
         typedef hardware_type::mutation_operator_type mutation_operator_type;
         typedef Traits traits_type;
         typedef metadata md_type;
-		typedef std::map<std::string, double> phenotype_type;
+		typedef task_phenotype phenotype_type;
         typedef int io_type;
         typedef std::deque<io_type> iobuffer_type;
         
@@ -63,6 +64,12 @@ namespace ealib {
         : _hw(r), _priority(1.0), _alive(true) {
 		}
         
+        //! Constructor that builds an organism from the representation [f,l).
+        template <typename ForwardIterator>
+        organism(ForwardIterator f, ForwardIterator l)
+        : _hw(f,l), _priority(1.0), _alive(true) {
+        }
+        
         //! Copy constructor.
         organism(const organism& that) {
             _hw = that._hw;
@@ -153,9 +160,26 @@ namespace ealib {
         //! Returns this individual's traits (const-qualified).
         const traits_type& traits() const { return _traits; }
         
+        /*! Rebuilds this organism from the representation [f,l), as though it
+         had just been constructed, while reusing its memory and buffers.
+         */
+        template <typename ForwardIterator>
+        void reset(ForwardIterator f, ForwardIterator l) {
+            _hw.assign(f, l);
+            _hw.initialize();
+            _priority = 1.0;
+            _position = position_type();
+            _alive = true;
+            _inputs.clear();
+            _outputs.clear();
+            _phenotype.clear();
+            _md.clear();
+            _traits = traits_type();
+        }
+        
         //! Execute this organism for n cycles.
         template <typename EA>
-        inline void execute(std::size_t n, typename EA::individual_ptr_type p, EA& ea) {
+        inline void execute(std::size_t n, const typename EA::individual_ptr_type& p, EA& ea) {
             _hw.execute(n, p, ea);
         }
 
@@ -0,0 +1,188 @@
+/* digital_evolution/phenotype.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester, Heather J. Goldsby.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EA_DIGITAL_EVOLUTION_PHENOTYPE_H_
+#define _EA_DIGITAL_EVOLUTION_PHENOTYPE_H_
+
+#include <boost/cstdint.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ealib {
+
+    /*! Task phenotype of a digital organism.
+
+     Tasks are identified by the dense IDs assigned to them by the task library
+     (see abstract_task::id()).  For each task, the phenotype holds the amount of
+     resources consumed by performing it; bitmasks track which tasks have been
+     performed at all, and which have consumed resources.
+
+     Task names are only used for reporting, via the task library, and for
+     reading checkpoints from before task IDs (version 0), in which phenotypes
+     were maps from task name to resources consumed; these are held until
+     resolve() converts them.
+     */
+    class task_phenotype {
+    public:
+        typedef boost::uint64_t mask_type;
+        typedef std::map<std::string,double> legacy_type;
+
+        //! Maximum number of tasks that can be tracked.
+        const static std::size_t MAX_TASKS = 64;
+
+        //! Constructor.
+        task_phenotype() : _performed(0), _consumed(0) {
+        }
+
+        //! Returns true if phenotypes are equivalent.
+        bool operator==(const task_phenotype& that) const {
+            if((_performed != that._performed) || (_consumed != that._consumed)) {
+                return false;
+            }
+            for(std::size_t i=0; i<std::max(_r.size(), that._r.size()); ++i) {
+                if(value(i) != that.value(i)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //! Record that task t was performed, consuming r resources.
+        void add(std::size_t t, double r) {
+            assert(t < MAX_TASKS);
+            if(t >= _r.size()) {
+                _r.resize(t+1, 0.0);
+            }
+            _r[t] += r;
+            _performed |= bit(t);
+            if(_r[t] > 0.0) {
+                _consumed |= bit(t);
+            } else {
+                _consumed &= ~bit(t);
+            }
+        }
+
+        //! Returns the resources consumed by task t.
+        double value(std::size_t t) const {
+            return (t < _r.size()) ? _r[t] : 0.0;
+        }
+
+        //! Returns true if task t was performed.
+        bool performed(std::size_t t) const {
+            return (_performed & bit(t)) != 0;
+        }
+
+        //! Returns true if task t consumed resources.
+        bool consumed(std::size_t t) const {
+            return (_consumed & bit(t)) != 0;
+        }
+
+        //! Returns true if any task other than t consumed resources.
+        bool consumed_other(std::size_t t) const {
+            return (_consumed & ~bit(t)) != 0;
+        }
+
+        //! Returns the mask of performed tasks.
+        mask_type performed_mask() const { return _performed; }
+
+        //! Returns the mask of tasks that consumed resources.
+        mask_type consumed_mask() const { return _consumed; }
+
+        //! Returns true if no tasks were performed.
+        bool empty() const { return _performed == 0; }
+
+        //! Forget all tasks (storage is kept for reuse).
+        void clear() {
+            std::fill(_r.begin(), _r.end(), 0.0);
+            _performed = 0;
+            _consumed = 0;
+            _legacy.clear();
+        }
+
+        /*! Converts tasks read by name from a version 0 checkpoint to the IDs
+         that task library tl assigned them; tasks that tl does not have are
+         dropped.
+         */
+        template <typename TaskLibrary>
+        void resolve(TaskLibrary& tl) {
+            for(legacy_type::iterator i=_legacy.begin(); i!=_legacy.end(); ++i) {
+                typename TaskLibrary::task_ptr_type t=tl.task(i->first);
+                if(t) {
+                    add(t->id(), i->second);
+                }
+            }
+            _legacy.clear();
+        }
+
+    protected:
+        //! Returns the bit for task t.
+        static mask_type bit(std::size_t t) {
+            return static_cast<mask_type>(1) << t;
+        }
+
+        std::vector<double> _r; //!< Resources consumed, by task ID.
+        mask_type _performed; //!< Tasks performed.
+        mask_type _consumed; //!< Tasks that consumed resources.
+        legacy_type _legacy; //!< Tasks by name, from a version 0 checkpoint (see resolve()).
+
+    private:
+        friend class boost::serialization::access;
+        template <class Archive>
+        void save(Archive& ar, const unsigned int version) const {
+            // storage kept by clear() is not saved:
+            std::size_t n=_r.size();
+            while((n > 0) && (_r[n-1] == 0.0)) {
+                --n;
+            }
+            std::vector<double> r(_r.begin(), _r.begin()+n);
+            ar & boost::serialization::make_nvp("resources", r);
+            ar & boost::serialization::make_nvp("performed", _performed);
+            ar & boost::serialization::make_nvp("consumed", _consumed);
+        }
+
+        template <class Archive>
+        void load(Archive& ar, const unsigned int version) {
+            clear();
+            if(version >= 1) {
+                ar & boost::serialization::make_nvp("resources", _r);
+                ar & boost::serialization::make_nvp("performed", _performed);
+                ar & boost::serialization::make_nvp("consumed", _consumed);
+            } else {
+                // version 0 phenotypes were a std::map, stored in place:
+                boost::serialization::load_map_collection(ar, _legacy);
+            }
+        }
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+    };
+
+} // ealib
+
+BOOST_CLASS_VERSION(ealib::task_phenotype, 1)
+
+#endif
@@ -115,22 +115,34 @@ namespace ealib {
         }
     };
     
-    /*! Replicates a parent p to produce an offspring with representation r.
+    /*! Replicates a parent p to produce offspring o, which must not yet have
+     been mutated or placed.
+     
+     This is the birth path for digital organisms; the offspring is mutated,
+     inherits from its parent, and is placed without building any temporary
+     populations (unless something is listening for inheritance events).
      */
     template <typename EA>
-    void replicate(typename EA::individual_ptr_type p, typename EA::genome_type& r, EA& ea) {
-        typename EA::population_type parents, offspring;
-        parents.push_back(p);
-        offspring.push_back(ea.make_individual(r));
-        
-        mutate(offspring.begin(), offspring.end(), ea);
-        inherits(parents, offspring, ea);
+    void replicate(typename EA::individual_ptr_type p, typename EA::individual_ptr_type o, EA& ea) {
+        mutate(*o, ea);
+        inherits_from(*p, *o, ea);
+        if(!ea.events().inheritance.empty()) {
+            typename EA::population_type parents(1, p);
+            ea.events().inheritance(parents, *o, ea);
+        }
         
         // parent is always reprioritized...
         ea.tasklib().prioritize(*p,ea);
         
         // this handles prioritizing the offspring:
-        ea.replace(*parents.begin(), *offspring.begin());
+        ea.replace(p, o);
+    }
+    
+    /*! Replicates a parent p to produce an offspring with representation r.
+     */
+    template <typename EA>
+    void replicate(typename EA::individual_ptr_type p, typename EA::genome_type& r, EA& ea) {
+        replicate(p, ea.make_individual(r.begin(), r.end()), ea);
     }
 
 } // ea
@@ -23,13 +23,14 @@
 
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/serialization/nvp.hpp>
-#include <boost/numeric/ublas/matrix.hpp>
+#include <algorithm>
 #include <utility>
 #include <vector>
 #include <stdexcept>
 
 #include <ea/algorithm.h>
 #include <ea/metadata.h>
+#include <ea/digital_evolution/diffusion.h>
 
 
 namespace ealib {
@@ -51,6 +52,13 @@ namespace ealib {
             //! Adds to the amount of resources available.
             virtual void contribute(double a) = 0;
             
+            /*! Adds to the amount of resources available to individual ind
+             (e.g., returning part of what it consumed).
+             */
+            virtual void contribute(double a, typename EA::individual_type& ind) {
+                contribute(a);
+            }
+            
             //! Returns the current resource level.
             virtual double level(const position_type& pos) = 0;
             
@@ -63,6 +71,14 @@ namespace ealib {
             //! Clears resource levels.
             virtual void clear() { };
             
+            /*! Splits this resource into k partitions (see
+             parallel::current_partition()) that are consumed independently.
+             */
+            virtual void partition(std::size_t k) { }
+            
+            //! Merges partitions back together.
+            virtual void merge() { }
+            
             //! Returns the name of this resource.
             virtual const std::string& name() { return _name; }
             
@@ -100,12 +116,19 @@ namespace ealib {
          Additional resources flow in over time (not all at once).
          
          This resource type is roughly akin to a chemostat.
+         
+         Updates are applied lazily: update() only counts them, and they are
+         applied (one at a time, exactly as they would have been when counted)
+         the next time the level is needed.  Once the level stops changing, the
+         remaining updates are skipped, so a resource that is rarely used costs
+         next to nothing.
          */
         template <typename EA>
         struct limited : abstract_resource<EA> {
             //! Constructor.
             limited(const std::string& name, double initial, double inflow, double outflow, double consume)
-            : abstract_resource<EA>(name), _initial(initial), _level(initial), _inflow(inflow), _outflow(outflow), _consume(consume) {
+            : abstract_resource<EA>(name), _initial(initial), _level(initial), _inflow(inflow), _outflow(outflow), _consume(consume)
+            , _delta_t(0.0), _pending(0) {
             }
             
             //! Destructor.
@@ -113,36 +136,94 @@ namespace ealib {
             
             //! Returns the amount of consumed resource.
             virtual double consume(typename EA::individual_type& ind) {
-                double r = std::max(0.0, _level*_consume);
-                _level = std::max(0.0, _level-r);
+                sync();
+                double& level = current();
+                double r = std::max(0.0, level*_consume);
+                level = std::max(0.0, level-r);
                 return r;
             }
             
             //! Adds to the amount of resources available.
             virtual void contribute(double a) {
-                _level += a;
+                sync();
+                current() += a;
             }
             
             //! Returns the current resource level.
-            virtual double level(const position_type& pos) { return _level; }
+            virtual double level(const position_type& pos) {
+                sync();
+                return current();
+            }
             
             //! Updates resource levels based on elapsed time since last update (as a fraction of update length).
             virtual void update(double delta_t) {
-                _level += delta_t * (_inflow - (_outflow * _level));
-                _level = std::max(0.0, _level);
+                if((_pending > 0) && (delta_t != _delta_t)) {
+                    sync();
+                }
+                _delta_t = delta_t;
+                ++_pending;
+            }
+            
+            /*! Applies pending updates.  This is a no-op while the resource is
+             partitioned, since updates are only made between partitions.
+             */
+            void sync() {
+                for( ; _pending>0; --_pending) {
+                    double l = std::max(0.0, _level + _delta_t * (_inflow - (_outflow * _level)));
+                    if(l == _level) {
+                        _pending = 0;
+                        break;
+                    }
+                    _level = l;
+                }
             }
             
             //! Resets resource levels.
-            virtual void reset() { _level = _initial; }
+            virtual void reset() { _level = _initial; _pending = 0; }
             
             //! Clears resource levels.
-            virtual void clear() { _level = 0.0; }
+            virtual void clear() { _level = 0.0; _pending = 0; }
+            
+            /*! Splits this resource into k partitions.  Each starts with the
+             whole current level, as though it were alone.
+             */
+            virtual void partition(std::size_t k) {
+                sync();
+                _shares.assign(k, _level);
+            }
+            
+            /*! Merges partitions; the level changes by the total change of all
+             partitions.
+             */
+            virtual void merge() {
+                double l=_level;
+                for(std::size_t i=0; i<_shares.size(); ++i) {
+                    l += _shares[i] - _level;
+                }
+                _level = std::max(0.0, l);
+                _shares.clear();
+            }
+            
+            //! Returns the level seen by the calling thread's partition.
+            double& current() {
+                if(!_shares.empty()) {
+                    std::size_t* i=parallel::current_partition().get();
+                    if(i != 0) {
+                        assert(*i < _shares.size());
+                        return _shares[*i];
+                    }
+                }
+                return _level;
+            }
             
+            std::vector<double> _shares; //!< Level of each partition.
             double _initial; //!< Initial resource level
             double _level; //!< Current resource level.
             double _inflow; //!< Amount of resource flowing in per update.
             double _outflow; //!< Rate at which resource flows out per update.
             double _consume; //!< Fraction of resource consumed.
+            double _delta_t; //!< Length of each pending update.
+            unsigned long _pending; //!< Number of updates not yet applied.
         };
         
         /*! Spatial resource type.
@@ -158,20 +239,30 @@ namespace ealib {
          the edges of the grid.  To avoid this, we alter the size of the resource
          grid to add a single-cell boundary around the spatial environment.
          
+         The diffusion step itself is done by diffusion_grid::sweep(); the
+         resource_vector runs it for all spatial resources in one pass.
+         
+         Without diffusion, the only cells that change over time are those that
+         resources flow into and out of, and each depends only on itself.  A
+         resource with a diffusion constant of zero therefore skips the stencil
+         entirely: update() only counts updates, and each of those cells applies
+         them the next time it is used.  Cells are caught up independently, so
+         this is safe while tiles of the environment run concurrently.
+         
          \note We assume a 2D discrete Cartesian environment.
          */
         template <typename EA>
         struct spatial : abstract_resource<EA> {
-            typedef boost::numeric::ublas::matrix<double> matrix_type; //!< Type for matrix that will store resource levels.
             
             //! Constructor.
             spatial(const std::string& name, double diffuse, double initial,
                     double inflow, double outflow, double consume, std::size_t x, std::size_t y)
             : abstract_resource<EA>(name)
-            , _diffuse(diffuse), _initial(initial), _level(initial)
-            , _inflow(inflow), _outflow(outflow), _consume(consume) {
+            , _diffuse(diffuse), _initial(initial)
+            , _inflow(inflow), _outflow(outflow), _consume(consume), _updates(0) {
                 _R.resize(x+2,y+2); // +2 for boundaries!
-                _T.resize(x+2,y+2);
+                _inflow_updates.resize(x+2);
+                _outflow_updates.resize(x+2);
                 reset();
             }
             
@@ -181,26 +272,52 @@ namespace ealib {
             //! Returns the amount of consumed resource.
             virtual double consume(typename EA::individual_type& ind) {
                 position_type& pos = ind.position();
+                sync(pos.r[0]+1, pos.r[1]+1);
                 double& level = _R(pos.r[0]+1, pos.r[1]+1); // +1 for boundaries!
                 double r = std::max(0.0, level*_consume);
                 level = std::max(0.0, level-r);
                 return r;
             }
             
-            //! Adds to the amount of resources available.
+            /*! Adds to the amount of resources available, spread evenly over
+             the environment.  This touches every cell, and so must not be
+             called while tiles of the environment run concurrently.
+             */
             virtual void contribute(double a) {
-                _level += a;
+                std::size_t nx=_R.size1()-1;
+                std::size_t ny=_R.size2()-1;
+                a /= static_cast<double>((nx-1) * (ny-1));
+                for(std::size_t i=1; i<nx; ++i) {
+                    for(std::size_t j=1; j<ny; ++j) {
+                        sync(i,j);
+                        _R(i,j) += a;
+                    }
+                }
+            }
+            
+            /*! Adds to the amount of resources available at individual ind's
+             location; the cell is owned by ind's tile, so this is safe while
+             tiles run concurrently.
+             */
+            virtual void contribute(double a, typename EA::individual_type& ind) {
+                position_type& pos = ind.position();
+                sync(pos.r[0]+1, pos.r[1]+1);
+                _R(pos.r[0]+1, pos.r[1]+1) += a;
             }
 
             //! Returns the current resource level.
             virtual double level(const position_type& pos) {
+                sync(pos.r[0]+1, pos.r[1]+1);
                 return _R(pos.r[0]+1, pos.r[1]+1);
             }
             
-            /*! Updates resource levels based on elapsed time since last update
-             (as a fraction of update length).
+            //! Returns true if this resource is updated lazily (i.e., it doesn't diffuse).
+            bool lazy() const { return _diffuse == 0.0; }
+            
+            /*! Applies inflow and outflow at the boundaries, and returns the
+             diffusion coefficient for a step of delta_t.
              */
-            void update(double delta_t) {
+            double flow(double delta_t) {
                 // for stability...
                 assert(delta_t < (1.0/(2.0*_diffuse)));
                 
@@ -218,38 +335,65 @@ namespace ealib {
                     _R(i,1) = std::max(0.0, _R(i,0) - _outflow);
                 }
                 
-                // two loops to evaluate the derivatives in the Laplacian,
-                // and calculating resource levels based on the previous time step:
-                for(std::size_t i=1; i<nx; ++i) {
-                    for(std::size_t j=1; j<ny; ++j) {
-                        double uxx = _R(i+1,j) - 2*_R(i,j) + _R(i-1,j);
-                        double uyy = _R(i,j+1) - 2*_R(i,j) + _R(i,j-1);
-                        _T(i,j) = _R(i,j) + delta_t * _diffuse * (uxx+uyy);
+                return delta_t * _diffuse;
+            }
+            
+            /*! Updates resource levels based on elapsed time since last update
+             (as a fraction of update length).
+             */
+            void update(double delta_t) {
+                if(lazy()) {
+                    ++_updates;
+                    return;
+                }
+                double k=flow(delta_t);
+                _R.sweep(k, 0, _R.size1());
+                _R.swap();
+            }
+            
+            /*! Applies pending updates to cell (i,j) of a lazy resource, as
+             flow() would have: inflow to the top row, then outflow from the
+             bottom row (which only depends on the boundary).
+             */
+            void sync(std::size_t i, std::size_t j) {
+                if(!lazy()) {
+                    return;
+                }
+                if(j == 1) {
+                    if(_outflow_updates[i] != _updates) {
+                        _R(i,1) = std::max(0.0, _R(i,0) - _outflow);
+                        _outflow_updates[i] = _updates;
+                    }
+                } else if(j == (_R.size2()-2)) {
+                    for(unsigned long& u=_inflow_updates[i]; u!=_updates; ++u) {
+                        _R(i,j) += _inflow;
                     }
                 }
-                _R.swap(_T);
             }
             
             //! Resets resource levels.
             void reset() {
-                _R = boost::numeric::ublas::scalar_matrix<double>(_R.size1(), _R.size2(), _initial);
-                _T = boost::numeric::ublas::scalar_matrix<double>(_R.size1(), _R.size2(), _initial);
+                _R.fill(_initial);
+                std::fill(_inflow_updates.begin(), _inflow_updates.end(), _updates);
+                std::fill(_outflow_updates.begin(), _outflow_updates.end(), _updates);
             }
             
             //! Clears resource levels.
             void clear() {
-                _R = boost::numeric::ublas::scalar_matrix<double>(_R.size1(), _R.size2(), 0.0);
-                _T = boost::numeric::ublas::scalar_matrix<double>(_R.size1(), _R.size2(), 0.0);
+                _R.fill(0.0);
+                std::fill(_inflow_updates.begin(), _inflow_updates.end(), _updates);
+                std::fill(_outflow_updates.begin(), _outflow_updates.end(), _updates);
             }
             
-            matrix_type _R; //!< Matrix for current resource levels at each cell.
-            matrix_type _T; //!< Matrix for updating resource levels at each cell.
+            diffusion_grid _R; //!< Resource levels at each cell.
             double _diffuse; //!< Diffusion constant for this resource.
             double _initial; //!< Initial resource level
-            double _level; //!< Current resource level.
             double _inflow; //!< Amount of resource flowing in per update.
             double _outflow; //!< Rate at which resource flows out per update.
             double _consume; //!< Fraction of resource consumed.
+            unsigned long _updates; //!< Number of updates (if lazy).
+            std::vector<unsigned long> _inflow_updates; //!< Updates applied to each cell of the top row (if lazy).
+            std::vector<unsigned long> _outflow_updates; //!< Updates applied to each cell of the bottom row (if lazy).
         };
         
     } // resources
@@ -288,16 +432,41 @@ namespace ealib {
             _resources.push_back(r);
         }
         
+        //! Splits all resources into k partitions.
+        void partition(std::size_t k) {
+            for(typename resource_list_type::iterator i=_resources.begin(); i!=_resources.end(); ++i) {
+                (*i)->partition(k);
+            }
+        }
+        
+        //! Merges partitions of all resources.
+        void merge() {
+            for(typename resource_list_type::iterator i=_resources.begin(); i!=_resources.end(); ++i) {
+                (*i)->merge();
+            }
+        }
+        
         //! Individual ind consumes resource r.
         double consume(resource_ptr_type r, typename EA::individual_type& ind) {
             return r->consume(ind);
         }
         
-        //! Updates resource levels based on delta t.
-        void update(double delta_t) {
+        /*! Updates resource levels based on delta t.
+         
+         Spatial resources are diffused together in a single pass, which uses
+         up to the given number of threads for large environments.
+         */
+        void update(double delta_t, std::size_t threads=1) {
+            diffusion_pass pass(threads);
             for(typename resource_list_type::iterator i=_resources.begin(); i!=_resources.end(); ++i) {
-                (*i)->update(delta_t);
+                detail::spatial<EA>* s=dynamic_cast<detail::spatial<EA>*>(i->get());
+                if((s == 0) || s->lazy()) {
+                    (*i)->update(delta_t);
+                } else {
+                    pass.add(s->_R, s->flow(delta_t));
+                }
             }
+            pass.run();
         }
         
     protected:
@@ -21,14 +21,19 @@
 #ifndef _EA_SCHEDULERS_H_
 #define _EA_SCHEDULERS_H_
 
+#include <algorithm>
 #include <list>
 #include <map>
+#include <vector>
 #include <ea/fitness_function.h>
+#include <ea/data_structures/fenwick_tree.h>
+#include <ea/parallel.h>
 
 namespace ealib {    
     
     LIBEA_MD_DECL(SCHEDULER_TIME_SLICE, "ea.scheduler.time_slice", unsigned int);
     LIBEA_MD_DECL(SCHEDULER_RESOURCE_SLICE, "ea.scheduler.resource_slice", unsigned int);
+    LIBEA_MD_DECL(SCHEDULER_QUANTUM, "ea.scheduler.quantum", unsigned int);
     
     typedef unary_fitness<double> priority_type; //!< Type for storing priorities.
     
@@ -51,7 +56,27 @@ namespace ealib {
         };
 
     } // access
-
+    
+    namespace detail {
+        /*! Removes dead individuals from the population (preserving the order
+         of those that remain), and hands them to the EA for recycling.
+         */
+        template <typename EA>
+        void prune(typename EA::population_type& population, EA& ea) {
+            typename EA::population_type::iterator j=population.begin();
+            for(typename EA::population_type::iterator i=population.begin(); i!=population.end(); ++i) {
+                if((*i)->alive()) {
+                    if(i != j) {
+                        j->swap(*i);
+                    }
+                    ++j;
+                } else {
+                    ea.recycle(*i);
+                }
+            }
+            population.erase(j, population.end());
+        }
+    } // detail
 
     /*! Weighted round-robin scheduler.
      
@@ -90,7 +115,7 @@ namespace ealib {
                 // to a partial resource update:
                 int period=consumed/ncycles_per_period;
                 if(period != last_period) {
-                    ea.resources().update(delta_t);
+                    ea.resources().update(delta_t, parallel::threads(ea));
                     last_period = period;
                 }
                 
@@ -109,15 +134,7 @@ namespace ealib {
             }
             
             // prune all dead organisms from the population:
-            typename EA::population_type next;
-            next.reserve(get<POPULATION_SIZE>(ea));
-            for(std::size_t i=0; i<population.size(); ++i) {
-                typename EA::individual_ptr_type p=population[i];
-                if(p->alive()) {
-                    next.push_back(p);
-                }
-            }
-            std::swap(population, next);
+            detail::prune(population, ea);
         }
         
         //! Link a standing population to this scheduler.
@@ -134,6 +151,100 @@ namespace ealib {
      CPU instruction per execution.
      */
     typedef weighted_round_robin<access::unit_priority> round_robin;
+    
+    /*! Weighted random scheduler.
+     
+     Executes individuals SCHEDULER_QUANTUM (default 1) CPU cycles at a time,
+     each time choosing an individual at random with probability proportional
+     to its priority (with a quantum of 1, this is the "probabilistic"
+     scheduler of Avida).  Over an update, each
+     individual receives the same expected number of cycles as under the
+     weighted_round_robin scheduler, but without visiting the population in
+     a fixed order.
+     
+     Priorities are held in a Fenwick tree, so choosing an individual and
+     changing its priority are both O(log N).  An individual's priority is
+     refreshed after each quantum it executes, which is when it can change
+     (e.g., when it replicates).  Individuals that are killed by others are
+     noticed when they are next chosen, at which point their priority is
+     zeroed and another individual is chosen instead.
+     
+     As with weighted_round_robin, offspring do not execute during the update
+     in which they are born, and dead individuals are removed from the
+     population at the end of each update; this is done in place.
+     
+     This scheduler operates in O(N + M log N) time, where N is population size
+     and M is the number of virtual CPU cycles scheduled during an update.
+     */
+    template <typename PriorityAccessor=access::priority>
+    struct weighted_random {
+        typedef PriorityAccessor accessor_type;
+        
+        template <typename EA>
+        void operator()(typename EA::population_type& population, EA& ea) {
+            // WARNING: Population is unstable!  Must use []-indexing.
+            const std::size_t N=population.size();
+            _w.resize(N);
+            for(std::size_t i=0; i<N; ++i) {
+                _w[i] = weight(*population[i], ea);
+            }
+            _tree.assign(_w.begin(), _w.end());
+            
+            const unsigned int eff_population_size = std::min(static_cast<unsigned int>(N),get<POPULATION_SIZE>(ea));
+            const long budget=get<SCHEDULER_TIME_SLICE>(ea) * eff_population_size;
+            const double delta_t = 1.0/static_cast<double>(get<SCHEDULER_RESOURCE_SLICE>(ea));
+            const long ncycles_per_period = budget * delta_t;
+            const std::size_t quantum = std::max(exists<SCHEDULER_QUANTUM>(ea) ? get<SCHEDULER_QUANTUM>(ea) : 1u, 1u);
+            
+            long consumed=0; // total consumed CPU cycles
+            int last_period=-1; // update period
+            double total=_tree.total(); // total priority
+            
+            while((consumed < budget) && (_tree.nonzero() > 0)) {
+                // updates are divided into periods, where each period corresponds
+                // to a partial resource update:
+                int period=consumed/ncycles_per_period;
+                if(period != last_period) {
+                    ea.resources().update(delta_t, parallel::threads(ea));
+                    last_period = period;
+                }
+                
+                std::size_t i=_tree.find(ea.rng().p() * total);
+                if(_tree.weight(i) <= 0.0) {
+                    break; // only reachable if rounding has left the total far from the weights
+                }
+                typename EA::individual_ptr_type p=population[i];
+                if(p->alive()) {
+                    p->execute(quantum, p, ea);
+                    consumed += quantum;
+                }
+                
+                double w=weight(*p, ea);
+                if(w != _tree.weight(i)) {
+                    _tree.update(i, w);
+                    total = _tree.total();
+                }
+            }
+            
+            // prune all dead organisms from the population:
+            detail::prune(population, ea);
+        }
+        
+        //! Returns the scheduling weight of individual ind.
+        template <typename EA>
+        double weight(typename EA::individual_type& ind, EA& ea) {
+            return ind.alive() ? std::max(static_cast<double>(_acc(ind,ea)), 0.0) : 0.0;
+        }
+        
+        //! Link a standing population to this scheduler.
+        template <typename EA>
+        void link(EA& ea) {
+        }
+        
+        accessor_type _acc; //!< Accessor for an individual's priority.
+        std::vector<double> _w; //!< Initial weights (kept to avoid reallocation).
+        fenwick_tree _tree; //!< Scheduling weights.
+    };
 
 } // ealib
 
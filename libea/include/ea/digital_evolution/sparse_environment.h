@@ -0,0 +1,380 @@
+/* digital_evolution/sparse_environment.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_SPARSE_ENVIRONMENT_H_
+#define _EA_DIGITAL_EVOLUTION_SPARSE_ENVIRONMENT_H_
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/signals2.hpp>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <ea/exceptions.h>
+#include <ea/metadata.h>
+#include <ea/digital_evolution/environment.h>
+
+namespace ealib {
+
+    /*! Sparse environment for individuals in a digital evolution algorithm.
+
+     This is a drop-in replacement for environment, with the same locations,
+     iterators, and neighborhoods, for very large worlds that are mostly empty
+     (e.g., 10,000 x 10,000 cells with 1% occupancy).  Instead of a dense torus,
+     locations are kept in a hash table keyed by cell index, and are created
+     the first time they are referenced.
+
+     At the end of every update in which the table has grown large enough,
+     locations that are neither occupied nor annotated (i.e., have empty
+     meta-data) are dropped, so memory use is proportional to the number of
+     occupied and annotated cells, not to the area of the world.  References to
+     locations, and location iterators, are stable until then.
+
+     Unlike environment, the population size is not limited to the number of
+     cells.  Locations are created on demand, so this environment can't be
+     used with a scheduler that runs individuals concurrently (e.g.,
+     tiled_round_robin).  Spatial resources are still dense, and typed location
+     data (environment::ldata()) is not available; use location meta-data.
+     */
+    template <typename EA>
+    class sparse_environment {
+    public:
+        typedef typename EA::individual_type individual_type;
+        typedef typename EA::individual_ptr_type individual_ptr_type;
+        typedef typename environment<EA>::location_type location_type;
+        typedef boost::uint64_t key_type;
+        typedef boost::unordered_map<key_type, location_type> location_storage_type;
+        typedef location_type* location_iterator;
+
+        //! Minimum number of stored locations before they are compacted.
+        const static std::size_t MIN_COMPACT=1024;
+
+        /*! This iterator is used to iterate over the locations in the neighborhood
+         of a given location.
+
+         \note Iteration begins at the currently-faced location, and proceeds ccw.
+         */
+        struct neighborhood_iterator : boost::iterator_facade<neighborhood_iterator, location_type, boost::single_pass_traversal_tag> {
+            //! Constructor.
+            neighborhood_iterator(const position_type& p, int c, sparse_environment& env)
+            : _x(p.r[0]), _y(p.r[1]), _heading(p.heading()), _count(c), _env(env) {
+            }
+
+            //! Increment operator.
+            void increment() {
+                ++_count;
+            }
+
+            //! Iterator equality comparison.
+            bool equal(const neighborhood_iterator& that) const {
+                return (_count == that._count) && (_x == that._x) && (_y == that._y);
+            }
+
+            //! Dereference this iterator.
+            location_type& dereference() const {
+                return _env.neighbor_location(_x, _y, _heading + _count);
+            }
+
+            //! Get an iterator to the location this neighborhood iterator points to.
+            location_iterator make_location_iterator() {
+                return &dereference();
+            }
+
+            int _x; //!< X coordinate of the origin location of this iterator.
+            int _y; //!< Y coordinate of the origin location of this iterator.
+            int _heading; //!< Heading of the first neighbor.
+            int _count; //!< Increment count for this iterator, used to check end.
+            sparse_environment& _env; //!< Environment.
+        };
+
+        //! Default constructor.
+        sparse_environment() : _size1(0), _size2(0), _next(0), _compact_at(MIN_COMPACT) {
+        }
+
+        /*! Operator==.
+
+         Locations that aren't stored are equal to empty locations.
+         */
+        bool operator==(const sparse_environment& that) const {
+            if((_size1 != that._size1) || (_size2 != that._size2)) {
+                return false;
+            }
+            return includes(that) && that.includes(*this);
+        }
+
+        //! Initializes the environment.
+        void initialize(EA& ea) {
+            _size1 = get<SPATIAL_X>(ea);
+            _size2 = get<SPATIAL_Y>(ea);
+            _locs.clear();
+            _next = 0;
+            connect(ea);
+        }
+
+        //! Returns the index of the location at position pos.
+        std::size_t index(const position_type& pos) const {
+            return _size2*wrap(pos.r[0], _size1) + wrap(pos.r[1], _size2);
+        }
+
+        //! Returns the number of locations currently stored.
+        std::size_t stored() const {
+            return _locs.size();
+        }
+
+        //! Drops all locations that are neither occupied nor annotated.
+        void compact() {
+            for(typename location_storage_type::iterator i=_locs.begin(); i!=_locs.end(); ) {
+                if(!i->second.occupied() && i->second._md.empty()) {
+                    i = _locs.erase(i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+
+        //! Clears all individuals from the environment.
+        void clear(EA& ea) {
+            _size1 = get<SPATIAL_X>(ea);
+            _size2 = get<SPATIAL_Y>(ea);
+            for(typename location_storage_type::iterator i=_locs.begin(); i!=_locs.end(); ++i) {
+                i->second.p.reset();
+            }
+            compact();
+            _next = 0;
+        }
+
+        /*! Links the individuals in the existing population to their positions
+         in the environment.
+
+         This method should be used whenever the environment loses track of the
+         individual pointers, e.g., upon deserialization or EA assignment.
+         */
+        void link(EA& ea) {
+            for(typename EA::population_type::iterator i=ea.population().begin(); i!=ea.population().end(); ++i) {
+                location((*i)->position()).p = *i;
+            }
+            connect(ea);
+        }
+
+        /*! Insert individual p at the next available location.
+
+         Locations are searched sequentially, starting after the last location
+         that was filled this way.
+         */
+        void insert(individual_ptr_type p, EA& ea) {
+            const key_type n=static_cast<key_type>(_size1)*_size2;
+            for(key_type c=0; c<n; ++c, _next=(_next+1)%n) {
+                typename location_storage_type::iterator i=_locs.find(_next);
+                if((i == _locs.end()) || !i->second.occupied()) {
+                    location_type& l=location(_next);
+                    l.p = p;
+                    p->position() = l.position();
+                    return;
+                }
+            }
+            // if we get here, the environment is full; throw.
+            throw fatal_error_exception("sparse_environment: could not find available location");
+        }
+
+        //! Insert individual p at the given position.
+        void insert_at(individual_ptr_type p, const position_type& pos, EA& ea) {
+            location_type& l=location(pos);
+            if(l.occupied()) {
+                throw fatal_error_exception("sparse_environment: position already occupied");
+            }
+            l.p = p;
+            p->position() = l.position();
+        }
+
+        //! Replaces an individual living at location i (if any) with individual p.
+        void replace(location_iterator i, individual_ptr_type p, EA& ea) {
+            location_type& l=(*i);
+            // kill the occupant of l, if any
+            if(l.p) {
+                l.p->alive() = false;
+                ea.events().death(*l.p,ea);
+            }
+            l.p = p;
+            p->position() = l.position();
+        }
+
+        //! Returns a location given a position.
+        location_type& location(const position_type& pos) {
+            return location(wrap(pos.r[0],_size1), wrap(pos.r[1],_size2));
+        }
+
+        //! Returns a location given (x,y) coordinates.
+        location_type& location(std::size_t x, std::size_t y) {
+            assert((x < _size1) && (y < _size2));
+            location_type& l=_locs[static_cast<key_type>(x)*_size2 + y];
+            l.r[0] = x;
+            l.r[1] = y;
+            return l;
+        }
+
+        //! Returns a location given an index.
+        location_type& location(std::size_t i) {
+            return location(i / _size2, i % _size2);
+        }
+
+        //! Returns the neighbor of location (x,y) in heading h (mod 8).
+        location_type& neighbor_location(int x, int y, int h) {
+            h &= 7;
+            return location(wrap(x + position_type::dx(h), _size1), wrap(y + position_type::dy(h), _size2));
+        }
+
+        //! Returns a [begin,end) pair of iterators over an individual's neighborhood.
+        std::pair<neighborhood_iterator,neighborhood_iterator> neighborhood(individual_type& p) {
+            return std::make_pair(neighborhood_iterator(p.position(), 0, *this),
+                                  neighborhood_iterator(p.position(), 8, *this));
+        }
+
+        //! Returns an iterator to the location currently faced by an individual.
+        location_iterator neighbor(individual_ptr_type p) {
+            const position_type& pos=p->position();
+            return &neighbor_location(pos.r[0], pos.r[1], pos.heading());
+        }
+
+        //! Swap individuals (if any) betweeen locations i and j.
+        void swap_locations(std::size_t i, std::size_t j) {
+            location_type& li=location(i);
+            location_type& lj=location(j);
+
+            // swap individual pointers:
+            std::swap(li.p, lj.p);
+
+            // and fixup positions:
+            if(li.occupied()) {
+                li.p->position() = li.position();
+            }
+            if(lj.occupied()) {
+                lj.p->position() = lj.position();
+            }
+        }
+
+        //! Rotates two individuals to face one another.
+        void face_org(individual_type& ind1, individual_type& ind2) {
+            face_positions(ind1.position(), ind2.position());
+        }
+
+    protected:
+        //! Returns v modulo n, in [0,n).
+        static std::size_t wrap(int v, std::size_t n) {
+            int m=static_cast<int>(n);
+            return static_cast<std::size_t>(((v % m) + m) % m);
+        }
+
+        //! Returns true if a location is occupied or annotated.
+        static bool used(const location_type& l) {
+            return ((l.p != 0) && l.p->alive()) || !l._md.empty();
+        }
+
+        //! Returns true if every used location in this is also in that.
+        bool includes(const sparse_environment& that) const {
+            for(typename location_storage_type::const_iterator i=_locs.begin(); i!=_locs.end(); ++i) {
+                if(!used(i->second)) {
+                    continue;
+                }
+                typename location_storage_type::const_iterator j=that._locs.find(i->first);
+                if(j == that._locs.end()) {
+                    return false;
+                }
+                const location_type& a=i->second;
+                const location_type& b=j->second;
+                bool ao=((a.p != 0) && a.p->alive()), bo=((b.p != 0) && b.p->alive());
+                if((ao != bo) || (ao && !((*a.p) == (*b.p)))
+                   || (a.r[0] != b.r[0]) || (a.r[1] != b.r[1]) || !(a._md == b._md)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /*! Compacts locations at the end of an update, if enough have been
+         added since the last compaction.
+         */
+        void end_of_update(EA& ea) {
+            if(_locs.size() >= _compact_at) {
+                compact();
+                _compact_at = std::max(static_cast<std::size_t>(MIN_COMPACT), 2*_locs.size());
+            }
+        }
+
+        //! Connects this environment to the EA's events.
+        void connect(EA& ea) {
+            _conn = ea.events().end_of_update.connect(boost::bind(&sparse_environment::end_of_update, this, _1));
+        }
+
+        std::size_t _size1; //!< Number of cells along x.
+        std::size_t _size2; //!< Number of cells along y.
+        key_type _next; //!< Index of the next location to try for insert().
+        std::size_t _compact_at; //!< Number of stored locations that triggers compaction.
+        location_storage_type _locs; //!< Stored locations, by index.
+        boost::signals2::scoped_connection _conn; //!< Connection to end_of_update.
+
+    private:
+        sparse_environment(const sparse_environment&);
+        sparse_environment& operator=(const sparse_environment&);
+
+        friend class boost::serialization::access;
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const {
+            // only annotated locations need to be saved; occupied locations
+            // are re-linked after load.  save them in index order:
+            std::vector<key_type> keys;
+            for(typename location_storage_type::const_iterator i=_locs.begin(); i!=_locs.end(); ++i) {
+                if(!i->second._md.empty()) {
+                    keys.push_back(i->first);
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+
+            std::size_t size1=_size1, size2=_size2, n=keys.size();
+            ar & boost::serialization::make_nvp("size1", size1);
+            ar & boost::serialization::make_nvp("size2", size2);
+            ar & boost::serialization::make_nvp("n", n);
+            for(std::size_t i=0; i<keys.size(); ++i) {
+                ar & boost::serialization::make_nvp("location", _locs.find(keys[i])->second);
+            }
+        }
+
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version) {
+            std::size_t n=0;
+            ar & boost::serialization::make_nvp("size1", _size1);
+            ar & boost::serialization::make_nvp("size2", _size2);
+            ar & boost::serialization::make_nvp("n", n);
+            _locs.clear();
+            for(std::size_t i=0; i<n; ++i) {
+                location_type l;
+                ar & boost::serialization::make_nvp("location", l);
+                location(l.r[0], l.r[1])._md = l._md;
+            }
+        }
+        BOOST_SERIALIZATION_SPLIT_MEMBER();
+    };
+
+} // ealib
+
+#endif
@@ -21,16 +21,88 @@
 #define _EA_DIGITAL_EVOLUTION_TASK_LIBRARY_H_
 
 #include <boost/shared_ptr.hpp>
+#include <algorithm>
 #include <string>
 #include <vector>
+#include <ea/exceptions.h>
 #include <ea/metadata.h>
 #include <ea/digital_evolution/events.h>
+#include <ea/digital_evolution/phenotype.h>
 
 LIBEA_MD_DECL(RESOURCE_GROUP_SIZE_THRESH, "ea.resource.group_size_thresh", int);
 LIBEA_MD_DECL(RESOURCE_FRACTION, "ea.resource.fraction", double);
 
 namespace ealib {
     
+    namespace tasks {
+        
+        /*! Bitwise logic functions of two inputs that the built-in task
+         predicates are defined in terms of.
+         
+         A task predicate that is satisfied when its output equals any one of a
+         set of these functions can be evaluated together with all other such
+         predicates by logic_functions(), below.
+         */
+        enum logic_function {
+            NOT_A=1<<0, //!< ~a
+            NOT_B=1<<1, //!< ~b
+            NAND=1<<2, //!< ~(a & b)
+            AND=1<<3, //!< a & b
+            ORNOT_A=1<<4, //!< a | ~b
+            ORNOT_B=1<<5, //!< ~a | b
+            OR=1<<6, //!< a | b
+            ANDNOT_A=1<<7, //!< a & ~b
+            ANDNOT_B=1<<8, //!< ~a & b
+            NOR=1<<9, //!< ~(a | b)
+            XOR=1<<10, //!< a ^ b
+            EQU=1<<11 //!< ~(a ^ b)
+        };
+        
+        //! Number of logic functions.
+        const std::size_t LOGIC_FUNCTIONS=12;
+        
+        //! Set of logic functions.
+        typedef unsigned int logic_mask_type;
+        
+        //! Returns the set of logic functions of in0 and in1 that are equal to out0.
+        inline logic_mask_type logic_functions(int in0, int in1, int out0) {
+            return (static_cast<logic_mask_type>(out0 == ~in0))
+            | (static_cast<logic_mask_type>(out0 == ~in1) << 1)
+            | (static_cast<logic_mask_type>(out0 == ~(in0 & in1)) << 2)
+            | (static_cast<logic_mask_type>(out0 == (in0 & in1)) << 3)
+            | (static_cast<logic_mask_type>(out0 == (in0 | ~in1)) << 4)
+            | (static_cast<logic_mask_type>(out0 == (~in0 | in1)) << 5)
+            | (static_cast<logic_mask_type>(out0 == (in0 | in1)) << 6)
+            | (static_cast<logic_mask_type>(out0 == (in0 & ~in1)) << 7)
+            | (static_cast<logic_mask_type>(out0 == (~in0 & in1)) << 8)
+            | (static_cast<logic_mask_type>(out0 == ~(in0 | in1)) << 9)
+            | (static_cast<logic_mask_type>(out0 == (in0 ^ in1)) << 10)
+            | (static_cast<logic_mask_type>(out0 == ~(in0 ^ in1)) << 11);
+        }
+        
+        /*! Logic functions that satisfy a task predicate.
+         
+         This is specialized for each built-in predicate; the default (0) means
+         that the predicate is opaque, and must be checked by calling it.
+         */
+        template <typename Predicate>
+        struct logic_traits {
+            static const logic_mask_type mask=0;
+        };
+        
+    } // tasks
+    
+    //! Returns the index of the lowest set bit in m, which must be nonzero.
+    inline std::size_t lowest_bit(task_phenotype::mask_type m) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(m);
+#else
+        std::size_t i=0;
+        for( ; !(m & 0x01); m >>= 1, ++i) ;
+        return i;
+#endif
+    }
+    
     /*! Abstract base class for all task types.
      
      Tasks depend on the type of resource that they consume/produce.
@@ -39,7 +111,7 @@ namespace ealib {
     struct abstract_task {
         typedef typename EA::resource_ptr_type resource_ptr_type; //!< Pointer to resource for this task.
         
-        abstract_task() : _limit(0.0), _exclusive(false) { }
+        abstract_task() : _id(0), _logic(0), _limit(0.0), _exclusive(false) { }
         
         virtual ~abstract_task() {
         }
@@ -47,6 +119,17 @@ namespace ealib {
         //! Returns the name of this task.
         virtual const std::string& name() = 0;
         
+        //! Returns the ID of this task (its index in the task library).
+        std::size_t id() const { return _id; }
+        
+        //! Sets the ID of this task.
+        void id(std::size_t i) { _id = i; }
+        
+        /*! Returns the logic functions that satisfy this task, or 0 if this
+         task can only be checked by calling check().
+         */
+        tasks::logic_mask_type logic() const { return _logic; }
+        
         //! Returns true if this task was performed, false otherwise.
         virtual bool check(int in0, int in1, int out0) = 0;
 
@@ -78,22 +161,21 @@ namespace ealib {
             bool r=true;
             
             // check to see if consumption of the associated resource is limited:
-            if(is_limited() && (ind.phenotype()[name()] >= limit())) {
+            if(is_limited() && (ind.phenotype().value(_id) >= limit())) {
                 r = false;
             }
             
-            // check to see if this task is exclusive:
-            if(r && is_exclusive()) {
-                for(typename EA::individual_type::phenotype_type::iterator i=ind.phenotype().begin(); i!=ind.phenotype().end(); ++i) {
-                    if((i->first != name()) && (i->second > 0.0)) {
-                        r = false;
-                    }
-                }
+            // check to see if this task is exclusive, i.e., no other task
+            // has consumed resources:
+            if(r && is_exclusive() && ind.phenotype().consumed_other(_id)) {
+                r = false;
             }
 
             return r;
         }
         
+        std::size_t _id; //!< ID of this task.
+        tasks::logic_mask_type _logic; //!< Logic functions that satisfy this task.
         double _limit;
         bool _exclusive;
     };
@@ -112,6 +194,7 @@ namespace ealib {
         
         //! Constructor.
         task(const std::string& name) : _name(name) {
+            this->_logic = tasks::logic_traits<Predicate>::mask;
         }
         
         virtual ~task() {
@@ -163,14 +246,77 @@ namespace ealib {
         typedef abstract_task<EA> abstract_task_type;
         typedef boost::shared_ptr<abstract_task_type> task_ptr_type;
         typedef std::vector<task_ptr_type> tasklist_type;
+        typedef task_phenotype::mask_type mask_type;
         
         //! Default constructor.
         task_library() {
+            std::fill(_logic_tasks, _logic_tasks+tasks::LOGIC_FUNCTIONS, 0);
         }
         
-        //! Append a task to the task library.
+        /*! Append a task to the task library, assigning it the next task ID.
+         
+         Tasks defined by logic functions are indexed by those functions, so that
+         they can all be checked at once; all others are checked individually.
+         */
         void append(task_ptr_type p) {
+            if(_tasklist.size() >= task_phenotype::MAX_TASKS) {
+                throw fatal_error_exception("task_library: too many tasks");
+            }
+            p->id(_tasklist.size());
             _tasklist.push_back(p);
+            
+            if(p->logic() == 0) {
+                _opaque.push_back(p);
+            } else {
+                for(std::size_t i=0; i<tasks::LOGIC_FUNCTIONS; ++i) {
+                    if(p->logic() & (1u << i)) {
+                        _logic_tasks[i] |= static_cast<mask_type>(1) << p->id();
+                    }
+                }
+            }
+        }
+        
+        /*! Returns the set of tasks (bit i is task ID i) performed by producing
+         output out0 from inputs in0 and in1.
+         */
+        mask_type performed(int in0, int in1, int out0) {
+            mask_type m=0;
+            tasks::logic_mask_type l=tasks::logic_functions(in0, in1, out0);
+            while(l) {
+                m |= _logic_tasks[lowest_bit(l)];
+                l &= l-1;
+            }
+            for(typename tasklist_type::iterator i=_opaque.begin(); i!=_opaque.end(); ++i) {
+                if((*i)->check(in0, in1, out0)) {
+                    m |= static_cast<mask_type>(1) << (*i)->id();
+                }
+            }
+            return m;
+        }
+        
+        /*! Returns the set of tasks performed by producing output out0 from
+         inputs in0 and in1, checking each task individually.
+         
+         This is equivalent to performed(), and is kept as a reference.
+         */
+        mask_type performed_by_task(int in0, int in1, int out0) {
+            mask_type m=0;
+            for(typename tasklist_type::iterator i=_tasklist.begin(); i!=_tasklist.end(); ++i) {
+                if((*i)->check(in0, in1, out0)) {
+                    m |= static_cast<mask_type>(1) << (*i)->id();
+                }
+            }
+            return m;
+        }
+        
+        //! Retrieve the task with the given name, or a null pointer if there is none.
+        task_ptr_type task(const std::string& name) {
+            for(typename tasklist_type::iterator i=_tasklist.begin(); i!=_tasklist.end(); ++i) {
+                if((*i)->name() == name) {
+                    return *i;
+                }
+            }
+            return task_ptr_type();
         }
 
         //! Retrieve the list of active tasks.
@@ -180,11 +326,11 @@ namespace ealib {
          */
         void prioritize(individual_type& org, EA& ea) {
             priority_type p=1.0;
+            task_phenotype& ph=org.phenotype();
             
-            for(typename tasklist_type::iterator i=_tasklist.begin(); i!=_tasklist.end(); ++i) {
-                abstract_task_type& task=(**i);
-                if(org.phenotype()[task.name()] > 0.0) {
-                    p = task.catalyze(org.phenotype()[task.name()], p);
+            for(std::size_t i=0; i<_tasklist.size(); ++i) {
+                if(ph.consumed(i)) {
+                    p = _tasklist[i]->catalyze(ph.value(i), p);
                 }
             }
             
@@ -196,8 +342,9 @@ namespace ealib {
          and record their performance in the individual's phenotype.
          
          This works by testing the latest iobuffer entries against all
-         tasks in the task library.  For every task performed, the individual's
-         phenotype is annotated with the amount of resources consumed.
+         tasks in the task library at once (see performed()).  For every task
+         performed, the individual's phenotype is annotated with the amount of
+         resources consumed.
          */
         void check_tasks(individual_type& org, EA& ea) {
             typedef typename EA::individual_type::iobuffer_type iobuffer_type;
@@ -206,22 +353,21 @@ namespace ealib {
             iobuffer_type& outputs = org.outputs();
             
             if((inputs.size() >= 2) && (!outputs.empty())) {
-                for(typename tasklist_type::iterator i=_tasklist.begin(); i!=_tasklist.end(); ++i) {
+                for(mask_type m=performed(inputs[0], inputs[1], outputs[0]); m; m &= m-1) {
+                    typename tasklist_type::iterator i=_tasklist.begin() + lowest_bit(m);
                     abstract_task_type& task=(**i);
-                    if(task.check(inputs[0], inputs[1], outputs[0])) {
-                        // ok, the *task* was performed.
-                        ea.events().task(org, *i, ea);
-                        
-                        if(task.reaction_occurs(org,ea)) {
-                            // if the reaction occurs, consume resources:
-                            double r = task.resource()->consume(org);
-                            org.phenotype()[task.name()] += r;
-                            ea.events().reaction(org, *i, r, ea);
-                        } else {
-                            // if the reaction did not occur, let's still update the
-                            // phenotype to indicate that the task was performed:
-                            org.phenotype()[task.name()] += 0.0;
-                        }
+                    // ok, the *task* was performed.
+                    ea.events().task(org, *i, ea);
+                    
+                    if(task.reaction_occurs(org,ea)) {
+                        // if the reaction occurs, consume resources:
+                        double r = task.resource()->consume(org);
+                        org.phenotype().add(task.id(), r);
+                        ea.events().reaction(org, *i, r, ea);
+                    } else {
+                        // if the reaction did not occur, let's still update the
+                        // phenotype to indicate that the task was performed:
+                        org.phenotype().add(task.id(), 0.0);
                     }
                 }
             }
@@ -236,30 +382,29 @@ namespace ealib {
             iobuffer_type& outputs = org.outputs();
             
             if((inputs.size() >= 2) && (!outputs.empty())) {
-                for(typename tasklist_type::iterator i=_tasklist.begin(); i!=_tasklist.end(); ++i) {
+                for(mask_type m=performed(inputs[0], inputs[1], outputs[0]); m; m &= m-1) {
+                    typename tasklist_type::iterator i=_tasklist.begin() + lowest_bit(m);
                     abstract_task_type& task=(**i);
-                    if(task.check(inputs[0], inputs[1], outputs[0])) {
-                        // ok, the *task* was performed.
-                        ea.events().task(org, *i, ea);
+                    // ok, the *task* was performed.
+                    ea.events().task(org, *i, ea);
+                    
+                    if(task.reaction_occurs(org,ea)) {
+                        // if the reaction occurs, consume resources:
+                        double r = task.resource()->consume(org);
+                        double mod_r = r;
                         
-                        if(task.reaction_occurs(org,ea)) {
-                            // if the reaction occurs, consume resources:
-                            double r = task.resource()->consume(org);
-                            double mod_r = r;
-                            
-                            if (ea.size() > get<RESOURCE_GROUP_SIZE_THRESH>(ea, ea.size())) {
-                                mod_r *= get<RESOURCE_FRACTION>(ea,1);
-                                // giving back extra resources
-                                task.resource()->contribute(r-mod_r);
-                            }
-                            
-                            org.phenotype()[task.name()] += mod_r;
-                            ea.events().reaction(org, *i, mod_r, ea);
-                        } else {
-                            // if the reaction did not occur, let's still update the
-                            // phenotype to indicate that the task was performed:
-                            org.phenotype()[task.name()] += 0.0;
+                        if (ea.size() > get<RESOURCE_GROUP_SIZE_THRESH>(ea, ea.size())) {
+                            mod_r *= get<RESOURCE_FRACTION>(ea,1);
+                            // giving back extra resources
+                            task.resource()->contribute(r-mod_r, org);
                         }
+                        
+                        org.phenotype().add(task.id(), mod_r);
+                        ea.events().reaction(org, *i, mod_r, ea);
+                    } else {
+                        // if the reaction did not occur, let's still update the
+                        // phenotype to indicate that the task was performed:
+                        org.phenotype().add(task.id(), 0.0);
                     }
                 }
             }
@@ -269,6 +414,8 @@ namespace ealib {
         
     protected:
         tasklist_type _tasklist; //!< Active tasks.
+        tasklist_type _opaque; //!< Tasks that are not defined by logic functions.
+        mask_type _logic_tasks[tasks::LOGIC_FUNCTIONS]; //!< Tasks satisfied by each logic function.
         
     private:
         task_library(const task_library&);
@@ -350,6 +497,16 @@ namespace ealib {
             }  
         };
         
+        template <> struct logic_traits<task_not> { static const logic_mask_type mask=NOT_A|NOT_B; };
+        template <> struct logic_traits<task_nand> { static const logic_mask_type mask=NAND; };
+        template <> struct logic_traits<task_and> { static const logic_mask_type mask=AND; };
+        template <> struct logic_traits<task_ornot> { static const logic_mask_type mask=ORNOT_A|ORNOT_B; };
+        template <> struct logic_traits<task_or> { static const logic_mask_type mask=OR; };
+        template <> struct logic_traits<task_andnot> { static const logic_mask_type mask=ANDNOT_A|ANDNOT_B; };
+        template <> struct logic_traits<task_nor> { static const logic_mask_type mask=NOR; };
+        template <> struct logic_traits<task_xor> { static const logic_mask_type mask=XOR; };
+        template <> struct logic_traits<task_equals> { static const logic_mask_type mask=EQU; };
+        
         //! True: always returns true. (Used for testing)
         struct task_true {
             bool operator()(int in0, int in1, int out0) {
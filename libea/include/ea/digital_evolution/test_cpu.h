@@ -0,0 +1,289 @@
+/* digital_evolution/test_cpu.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_TEST_CPU_H_
+#define _EA_DIGITAL_EVOLUTION_TEST_CPU_H_
+
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/signals2.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/mutation.h>
+#include <ea/parallel.h>
+#include <ea/rng.h>
+#include <ea/digital_evolution/environment.h>
+#include <ea/digital_evolution/phenotype.h>
+
+namespace ealib {
+
+    LIBEA_MD_DECL(TEST_CPU_TIME_MOD, "ea.test_cpu.time_mod", unsigned int);
+
+    /*! Phenotype of a genome, as measured by a test CPU.
+     */
+    struct test_phenotype {
+        typedef task_phenotype::mask_type mask_type;
+
+        //! Constructor.
+        test_phenotype() : viable(false), tasks(0), cycles(0), offspring_size(0), fidelity(0.0) {
+        }
+
+        //! Returns true if both phenotypes are the same.
+        bool operator==(const test_phenotype& that) const {
+            return (viable == that.viable) && (tasks == that.tasks) && (cycles == that.cycles)
+            && (offspring_size == that.offspring_size) && (fidelity == that.fidelity);
+        }
+
+        bool viable; //!< True if the genome divided.
+        mask_type tasks; //!< Tasks performed before dividing.
+        std::size_t cycles; //!< Cycles executed before dividing (gestation time).
+        std::size_t offspring_size; //!< Size of the offspring's genome.
+        double fidelity; //!< Fraction of the genome that the offspring copied exactly.
+    };
+
+
+    /*! Test CPU: runs genomes in isolation to measure their phenotypes.
+
+     Each genome is placed alone in the middle of a small, private world that
+     is built from the same metadata (and lifecycle) as the EA the test CPU was
+     constructed from, except that mutations are disabled.  It runs with fixed
+     inputs until it divides, or until it has executed TEST_CPU_TIME_MOD
+     (default 20) cycles per instruction in its genome.  The private world is
+     reset (see digital_evolution::reset()) before every run, so a genome's
+     phenotype does not depend on when, or on which thread, it was measured.
+
+     Results are cached by genome.  evaluate() may be called concurrently from
+     any number of threads; each call runs genomes in a private world of its
+     own (worlds are kept for reuse), and only the cache is shared.
+     */
+    template <typename EA>
+    class test_cpu {
+    public:
+        typedef EA ea_type;
+        typedef typename EA::genome_type genome_type;
+        typedef typename EA::individual_type individual_type;
+        typedef typename EA::individual_ptr_type individual_ptr_type;
+
+        //! Hash of a genome.
+        struct genome_hash {
+            std::size_t operator()(const genome_type& g) const {
+                return boost::hash_range(g.begin(), g.end());
+            }
+        };
+
+        typedef boost::unordered_map<genome_type, test_phenotype, genome_hash> cache_type;
+
+        //! First fixed input (the same as those used by fixed_input).
+        const static int INPUT0=856220990;
+        //! Second fixed input.
+        const static int INPUT1=252908703;
+
+        //! Constructor; test worlds will be built from ea's metadata.
+        test_cpu(EA& ea) : _time_mod(20), _threads(1) {
+            if(exists<TEST_CPU_TIME_MOD>(ea)) {
+                _time_mod = get<TEST_CPU_TIME_MOD>(ea);
+            }
+            if(exists<PARALLEL_THREADS>(ea)) {
+                _threads = std::max(get<PARALLEL_THREADS>(ea), 1u);
+            }
+            // copying with += shares no attributes with ea, whose own values
+            // would otherwise be changed by the puts below:
+            metadata md;
+            md += ea.md();
+            put<MUTATION_PER_SITE_P>(0.0, md);
+            put<POPULATION_SIZE>(9, md);
+            put<SPATIAL_X>(3, md);
+            put<SPATIAL_Y>(3, md);
+            if(!exists<RNG_SEED>(md)) {
+                put<RNG_SEED>(1, md);
+            }
+            // test worlds are reset from _md on any thread, so it holds only
+            // strings, which are safe to copy concurrently:
+            _md += md;
+        }
+
+        //! Destructor.
+        virtual ~test_cpu() {
+            for(typename std::vector<EA*>::iterator i=_idle.begin(); i!=_idle.end(); ++i) {
+                delete *i;
+            }
+        }
+
+        //! Returns the phenotype of genome g, running it if it is not cached.
+        test_phenotype evaluate(const genome_type& g) {
+            EA* w=acquire();
+            test_phenotype p=evaluate_in(g, *w);
+            release(w);
+            return p;
+        }
+
+        //! Evaluates the genomes [f,l) (which must be random access), on up to PARALLEL_THREADS threads.
+        template <typename RandomAccessIterator>
+        void evaluate(RandomAccessIterator f, RandomAccessIterator l) {
+            std::size_t k=std::min(_threads, static_cast<std::size_t>(l-f));
+            range_chunk<RandomAccessIterator> rc(f, *this);
+            for(std::size_t i=0; i<k; ++i) {
+                rc._worlds.push_back(acquire());
+            }
+            parallel::for_each_chunk(l-f, k, rc);
+            for(std::size_t i=0; i<k; ++i) {
+                release(rc._worlds[i]);
+            }
+        }
+
+        //! Returns true if genome g has been evaluated.
+        bool cached(const genome_type& g) {
+            boost::mutex::scoped_lock lock(_mutex);
+            return _cache.find(g) != _cache.end();
+        }
+
+        //! Returns the number of cached phenotypes.
+        std::size_t size() {
+            boost::mutex::scoped_lock lock(_mutex);
+            return _cache.size();
+        }
+
+        //! Discards all cached phenotypes.
+        void clear() {
+            boost::mutex::scoped_lock lock(_mutex);
+            _cache.clear();
+        }
+
+    protected:
+        //! Evaluates genomes [b,e) of a range, for parallel::for_each_chunk.
+        template <typename RandomAccessIterator>
+        struct range_chunk {
+            range_chunk(RandomAccessIterator f, test_cpu& cpu) : _f(f), _cpu(cpu) {
+            }
+
+            void operator()(std::size_t b, std::size_t e, std::size_t i) {
+                for( ; b!=e; ++b) {
+                    _cpu.evaluate_in(*(_f+b), *_worlds[i]);
+                }
+            }
+
+            RandomAccessIterator _f;
+            test_cpu& _cpu;
+            std::vector<EA*> _worlds; //!< Test world for each chunk.
+        };
+
+        //! Records the first offspring born in a test world.
+        struct birth_recorder {
+            birth_recorder() : born(false) {
+            }
+
+            void operator()(individual_type& offspring, individual_type& parent, EA& ea) {
+                if(!born) {
+                    born = true;
+                    offspring_genome = offspring.repr();
+                }
+            }
+
+            bool born;
+            genome_type offspring_genome;
+        };
+
+        //! Returns the phenotype of genome g, running it in world w if it is not cached.
+        test_phenotype evaluate_in(const genome_type& g, EA& w) {
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                typename cache_type::iterator i=_cache.find(g);
+                if(i != _cache.end()) {
+                    return i->second;
+                }
+            }
+            test_phenotype p=run(g, w);
+            boost::mutex::scoped_lock lock(_mutex);
+            _cache.insert(std::make_pair(g, p));
+            return p;
+        }
+
+        //! Takes an idle test world, building a new one if there are none.
+        EA* acquire() {
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                if(!_idle.empty()) {
+                    EA* w=_idle.back();
+                    _idle.pop_back();
+                    return w;
+                }
+            }
+            EA* w=new EA();
+            w->initialize(_md);
+            return w;
+        }
+
+        //! Returns test world w to the idle list.
+        void release(EA* w) {
+            boost::mutex::scoped_lock lock(_mutex);
+            _idle.push_back(w);
+        }
+
+        //! Runs genome g in test world w.
+        test_phenotype run(const genome_type& g, EA& w) {
+            w.reset(_md);
+
+            individual_ptr_type p=w.make_individual(g);
+            put<IND_GENERATION>(0.0, *p);
+            p->inputs().push_back(static_cast<int>(INPUT0));
+            p->inputs().push_back(static_cast<int>(INPUT1));
+            w.insert_at(w.end(), p, position_type(1,1));
+
+            birth_recorder br;
+            boost::signals2::scoped_connection conn=w.events().birth.connect(boost::ref(br));
+
+            test_phenotype t;
+            const std::size_t limit=_time_mod * g.size();
+            while(!br.born && p->alive() && (t.cycles < limit)) {
+                p->hw().execute(1, p, w);
+                ++t.cycles;
+            }
+
+            t.viable = br.born;
+            t.tasks = p->phenotype().performed_mask();
+            if(br.born) {
+                t.offspring_size = br.offspring_genome.size();
+                std::size_t n=std::min(g.size(), br.offspring_genome.size());
+                std::size_t same=0;
+                for(std::size_t i=0; i<n; ++i) {
+                    if(g[i] == br.offspring_genome[i]) {
+                        ++same;
+                    }
+                }
+                t.fidelity = static_cast<double>(same) / static_cast<double>(std::max(g.size(), br.offspring_genome.size()));
+            }
+            w.clear();
+            return t;
+        }
+
+        metadata _md; //!< Metadata for test worlds.
+        std::size_t _time_mod; //!< Maximum cycles per instruction.
+        std::size_t _threads; //!< Threads used to evaluate ranges of genomes.
+        boost::mutex _mutex; //!< Guards the cache and the idle test worlds.
+        cache_type _cache; //!< Cached phenotypes.
+        std::vector<EA*> _idle; //!< Test worlds that are not in use.
+    };
+
+} // ealib
+
+#endif
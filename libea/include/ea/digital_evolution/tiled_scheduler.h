@@ -0,0 +1,334 @@
+/* digital_evolution/tiled_scheduler.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_TILED_SCHEDULER_H_
+#define _EA_DIGITAL_EVOLUTION_TILED_SCHEDULER_H_
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/barrier.hpp>
+#include <algorithm>
+#include <vector>
+
+#include <ea/metadata.h>
+#include <ea/parallel.h>
+#include <ea/digital_evolution/environment.h>
+#include <ea/digital_evolution/schedulers.h>
+
+namespace ealib {
+
+    LIBEA_MD_DECL(SCHEDULER_TILE_SIZE, "ea.scheduler.tile_size", unsigned int);
+
+    namespace detail {
+
+        /*! Returns the number of tiles along an axis of n cells, given a
+         requested tile width w.
+
+         This is either 1, or an even number of tiles that are each at least
+         max(w,2) cells wide.  An even number of tiles can be 2-colored even
+         though the axis wraps around.
+         */
+        inline std::size_t tile_count(std::size_t n, std::size_t w) {
+            std::size_t k = n / std::max(w, static_cast<std::size_t>(2));
+            if(k < 2) {
+                return 1;
+            }
+            return k - (k % 2);
+        }
+
+        /*! A rectangular tile of the environment, together with the state that
+         it needs to run independently of all other tiles.
+
+         Events raised while the tile runs are recorded, and replayed on the
+         EA's event handler (in order) when the tile's offspring are merged
+         into the population.
+         */
+        template <typename EA>
+        struct tile {
+            typedef typename EA::individual_type individual_type;
+            typedef typename EA::population_type population_type;
+            typedef typename EA::task_library_type::task_ptr_type task_ptr_type;
+
+            //! Kinds of recorded events.
+            enum kind_type { BIRTH, DEATH, INHERITANCE, TASK, REACTION };
+
+            //! A recorded event.
+            struct record {
+                kind_type kind;
+                individual_type* ind;
+                individual_type* other;
+                task_ptr_type task;
+                double r;
+                std::size_t parents;
+            };
+
+            //! Constructor; seeds this tile's RNG from the EA's.
+            tile(EA& ea) : consumed(0), budget(0), i(0) {
+                local.rng.reset(ea.rng().seed());
+                local.md += ea.md();
+                local.events.birth.connect(boost::bind(&tile::birth, this, _1, _2));
+                local.events.death.connect(boost::bind(&tile::death, this, _1));
+                local.events.inheritance.connect(boost::bind(&tile::inheritance, this, _1, _2));
+                local.events.task.connect(boost::bind(&tile::task, this, _1, _2));
+                local.events.reaction.connect(boost::bind(&tile::reaction, this, _1, _2, _3));
+            }
+
+            /*! Executes the individuals in this tile round-robin until at least
+             target cycles have been consumed, or none of them can run.
+             */
+            template <typename Accessor>
+            void run(long target, std::size_t partition, Accessor& acc, EA& ea) {
+                parallel::current_partition().reset(&partition);
+                ea.localize(&local);
+                std::size_t idle=0;
+                while((consumed < target) && (idle < orgs.size())) {
+                    typename EA::individual_ptr_type p=orgs[i];
+                    std::size_t n=0;
+                    if(p->alive()) {
+                        n = static_cast<std::size_t>(acc(*p,ea));
+                        p->execute(n, p, ea);
+                        consumed += n;
+                    }
+                    idle = (n > 0) ? 0 : (idle+1);
+                    i = (i+1) % orgs.size();
+                }
+                ea.localize(0);
+                parallel::current_partition().reset(0);
+            }
+
+            //! Appends offspring to the population and replays recorded events.
+            void merge(population_type& population, EA& ea) {
+                population.insert(population.end(), local.offspring.begin(), local.offspring.end());
+                local.offspring.clear();
+                for(std::size_t j=0; j<records.size(); ++j) {
+                    record& r=records[j];
+                    switch(r.kind) {
+                        case BIRTH: ea.events().birth(*r.ind, *r.other, ea); break;
+                        case DEATH: ea.events().death(*r.ind, ea); break;
+                        case INHERITANCE: ea.events().inheritance(parents[r.parents], *r.ind, ea); break;
+                        case TASK: ea.events().task(*r.ind, r.task, ea); break;
+                        case REACTION: ea.events().reaction(*r.ind, r.task, r.r, ea); break;
+                    }
+                }
+                records.clear();
+                parents.clear();
+            }
+
+            //! Records an event.
+            void add(kind_type k, individual_type* ind, individual_type* other=0,
+                     task_ptr_type t=task_ptr_type(), double r=0.0, std::size_t p=0) {
+                record x = { k, ind, other, t, r, p };
+                records.push_back(x);
+            }
+
+            void birth(individual_type& offspring, individual_type& parent) {
+                add(BIRTH, &offspring, &parent);
+            }
+
+            void death(individual_type& ind) {
+                add(DEATH, &ind);
+            }
+
+            void inheritance(population_type& p, individual_type& offspring) {
+                parents.push_back(p);
+                add(INHERITANCE, &offspring, 0, task_ptr_type(), 0.0, parents.size()-1);
+            }
+
+            void task(individual_type& ind, task_ptr_type t) {
+                add(TASK, &ind, 0, t);
+            }
+
+            void reaction(individual_type& ind, task_ptr_type t, double r) {
+                add(REACTION, &ind, 0, t, r);
+            }
+
+            typename EA::local_state local; //!< Thread-local state for this tile.
+            population_type orgs; //!< Individuals in this tile at the start of the update.
+            long consumed; //!< Cycles consumed during this update.
+            long budget; //!< Cycles available during this update.
+            std::size_t i; //!< Index of the next individual to execute.
+            std::vector<record> records; //!< Recorded events.
+            std::vector<population_type> parents; //!< Parents of recorded inheritance events.
+        };
+
+        /*! Runs one update of a tiled scheduler on a fixed set of worker
+         threads; see tiled_round_robin.
+         */
+        template <typename EA, typename Accessor>
+        struct tiled_update {
+            typedef boost::shared_ptr<tile<EA> > tile_ptr_type;
+
+            //! Constructor.
+            tiled_update(std::vector<tile_ptr_type>& tiles, std::vector<std::size_t>* colors,
+                         std::size_t threads, Accessor& acc, typename EA::population_type& population, EA& ea)
+            : _tiles(tiles), _colors(colors), _threads(threads), _barrier(static_cast<unsigned int>(threads))
+            , _acc(acc), _population(population), _ea(ea) {
+            }
+
+            /*! Body of worker w.
+
+             Worker 0 also performs the serial parts of the update (resource
+             updates and merges) while all other workers wait at a barrier.
+             */
+            void operator()(std::size_t, std::size_t, std::size_t w) {
+                const std::size_t periods=get<SCHEDULER_RESOURCE_SLICE>(_ea);
+                const double delta_t=1.0/static_cast<double>(periods);
+
+                for(std::size_t p=0; p<periods; ++p) {
+                    if(w == 0) {
+                        _ea.resources().update(delta_t, parallel::threads(_ea));
+                    }
+                    for(std::size_t c=0; c<4; ++c) {
+                        std::vector<std::size_t>& color=_colors[c];
+                        if(color.empty()) {
+                            continue;
+                        }
+                        if(w == 0) {
+                            _ea.resources().partition(color.size());
+                        }
+                        _barrier.wait();
+                        for(std::size_t j=w; j<color.size(); j+=_threads) {
+                            tile<EA>& t=*_tiles[color[j]];
+                            t.run(t.budget * static_cast<long>(p+1) / static_cast<long>(periods), j, _acc, _ea);
+                        }
+                        _barrier.wait();
+                        if(w == 0) {
+                            _ea.resources().merge();
+                            for(std::size_t j=0; j<color.size(); ++j) {
+                                _tiles[color[j]]->merge(_population, _ea);
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::vector<tile_ptr_type>& _tiles; //!< All tiles.
+            std::vector<std::size_t>* _colors; //!< Indices of tiles of each color.
+            std::size_t _threads; //!< Number of worker threads.
+            boost::barrier _barrier; //!< Synchronizes workers between phases.
+            Accessor& _acc; //!< Accessor for an individual's priority.
+            typename EA::population_type& _population; //!< Population.
+            EA& _ea; //!< EA.
+        };
+
+    } // detail
+
+
+    /*! Tiled (domain-decomposed) weighted round-robin scheduler.
+
+     The environment is split into tiles of about SCHEDULER_TILE_SIZE x
+     SCHEDULER_TILE_SIZE cells (see detail::tile_count()), and each tile is
+     scheduled like weighted_round_robin: the individuals in it at the start of
+     the update are shuffled and run round-robin, for a budget of
+     SCHEDULER_TIME_SLICE cycles per individual.  Tiles are colored like a
+     checkerboard with four colors; each resource period runs every tile of one
+     color, then the next, on up to PARALLEL_THREADS threads.
+
+     Tiles of the same color are at least two cells apart, so individuals in
+     them can't touch the same cell or neighbor (given a replacement strategy
+     and instructions that reach at most one cell away, as all built-in ones
+     do), and changes to the environment are applied immediately.  What can't
+     be shared is made local to each tile: every tile has its own RNG (seeded
+     from the EA's RNG, in tile order), copy of the EA's meta-data, and share
+     of each limited resource.  Offspring and events are queued in their tile,
+     and are merged into the population and replayed on the EA's event handler
+     at the end of each phase, in tile order.
+
+     As a result, an update depends only on the RNG seed and the tiling, and
+     not on the number of threads.  It is not the same as an update of
+     weighted_round_robin, which interleaves all individuals.
+
+     Every tile has a fixed cost per update and per phase, so tiles should
+     hold at least a few dozen individuals; the default tile size is 8.
+
+     Event handlers see events from a whole phase at once, after the fact;
+     they run on the main thread, and must not assume that the environment
+     hasn't changed since the event occurred.
+     */
+    template <typename PriorityAccessor=access::priority>
+    struct tiled_round_robin {
+        typedef PriorityAccessor accessor_type;
+
+        template <typename EA>
+        void operator()(typename EA::population_type& population, EA& ea) {
+            typedef detail::tile<EA> tile_type;
+            typedef boost::shared_ptr<tile_type> tile_ptr_type;
+
+            const std::size_t X=get<SPATIAL_X>(ea);
+            const std::size_t Y=get<SPATIAL_Y>(ea);
+            const std::size_t w=get<SCHEDULER_TILE_SIZE>(ea,8);
+            const std::size_t nx=detail::tile_count(X,w);
+            const std::size_t ny=detail::tile_count(Y,w);
+
+            // which tile column (row) each x (y) falls in:
+            std::vector<std::size_t> tx(X), ty(Y);
+            for(std::size_t i=0; i<nx; ++i) {
+                std::pair<std::size_t,std::size_t> c=parallel::chunk(i,nx,X);
+                std::fill(tx.begin()+c.first, tx.begin()+c.second, i);
+            }
+            for(std::size_t j=0; j<ny; ++j) {
+                std::pair<std::size_t,std::size_t> c=parallel::chunk(j,ny,Y);
+                std::fill(ty.begin()+c.first, ty.begin()+c.second, j);
+            }
+
+            std::vector<tile_ptr_type> tiles(nx*ny);
+            std::vector<std::size_t> colors[4];
+            for(std::size_t j=0; j<ny; ++j) {
+                for(std::size_t i=0; i<nx; ++i) {
+                    tiles[j*nx+i].reset(new tile_type(ea));
+                    colors[(i%2) + 2*(j%2)].push_back(j*nx+i);
+                }
+            }
+
+            for(std::size_t i=0; i<population.size(); ++i) {
+                typename EA::individual_ptr_type p=population[i];
+                if(p->alive()) {
+                    position_type& pos=p->position();
+                    tiles[ty[pos.r[1]]*nx + tx[pos.r[0]]]->orgs.push_back(p);
+                }
+            }
+
+            const long time_slice=get<SCHEDULER_TIME_SLICE>(ea);
+            for(std::size_t i=0; i<tiles.size(); ++i) {
+                tile_type& t=*tiles[i];
+                std::random_shuffle(t.orgs.begin(), t.orgs.end(), t.local.rng);
+                t.budget = time_slice * static_cast<long>(t.orgs.size());
+            }
+
+            const std::size_t threads=std::min(parallel::threads(ea), tiles.size());
+            detail::tiled_update<EA,accessor_type> u(tiles, colors, threads, _acc, population, ea);
+            ea.enable_local_state(true);
+            parallel::for_each_chunk(threads, threads, u);
+            ea.enable_local_state(false);
+
+            // prune all dead organisms from the population:
+            detail::prune(population, ea);
+        }
+
+        //! Link a standing population to this scheduler.
+        template <typename EA>
+        void link(EA& ea) {
+        }
+
+        accessor_type _acc; //!< Accessor for an individual's priority.
+    };
+
+} // ealib
+
+#endif
@@ -0,0 +1,411 @@
+/* digital_evolution/trace.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_DIGITAL_EVOLUTION_TRACE_H_
+#define _EA_DIGITAL_EVOLUTION_TRACE_H_
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_set.hpp>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <ea/exceptions.h>
+#include <ea/metadata.h>
+#include <ea/digital_evolution/hardware.h>
+
+namespace ealib {
+
+    /*! One instruction in an execution trace.
+
+     Records are a fixed 32 bytes, and are written to trace files as-is (in
+     native byte order).  The registers and heads are those in effect just
+     before the instruction was executed.
+     */
+    struct trace_record {
+        boost::uint32_t update; //!< Update during which the instruction was executed.
+        boost::uint32_t organism; //!< ID of the organism that executed it.
+        boost::uint16_t ip; //!< Position of the instruction in the organism's memory.
+        boost::uint16_t opcode; //!< Opcode of the instruction.
+        boost::int32_t regs[hardware::NUM_REGISTERS]; //!< Registers.
+        boost::uint16_t heads[hardware::NUM_HEADS]; //!< Head positions.
+    };
+
+    BOOST_STATIC_ASSERT(sizeof(trace_record) == 32);
+
+    namespace detail {
+        //! Magic string at the start of every trace file.
+        inline const char* trace_magic() { return "EATRACE1"; }
+    }
+
+
+    /*! Records the instructions executed by organisms to a compressed binary
+     file.
+
+     While a trace is attached to an EA (see digital_evolution::trace()), the
+     hardware reports every instruction it executes.  Whether an organism is
+     traced is decided once per call to hardware::execute(): it must pass the
+     organism and genotype filters (if any), and is then sampled with
+     probability sample_p() (default 1.0).
+
+     Records are appended to a block owned by the calling thread, so that
+     tracing needs no locks while organisms run, even with a multi-threaded
+     scheduler.  Full blocks are handed to a writer thread, which compresses
+     them (gzip) and writes them to the trace file; written blocks are reused.
+     flush() hands over partially-filled blocks, and must only be called while
+     no organism is executing (it is called at the end of every update, and
+     when the trace is destroyed).
+
+     Threads must not outlive the trace once they have traced an organism
+     (the schedulers join their threads within each update).
+
+     Organism IDs are 32-bit hashes of each organism's unique name.  Genotype
+     filters compare the hash of the first original_size() instructions of an
+     organism's memory, i.e., the genome that it was born with (unless it has
+     since overwritten it).
+     */
+    template <typename EA>
+    class execution_trace {
+    public:
+        typedef typename EA::individual_type individual_type;
+        typedef typename EA::genome_type genome_type;
+        typedef std::vector<trace_record> block_type;
+
+        //! Default number of records per block.
+        const static std::size_t BLOCK_SIZE=4096;
+
+        //! Constructor; attaches this trace to ea, writing to file filename.
+        execution_trace(const std::string& filename, EA& ea, std::size_t block_size=BLOCK_SIZE)
+        : _ea(ea), _block_size(block_size), _sample_p(1.0), _done(false), _records(0), _tls(&execution_trace::retire) {
+            _out.push(boost::iostreams::gzip_compressor());
+            _out.push(boost::iostreams::file_sink(filename, std::ios_base::out | std::ios_base::binary));
+            boost::uint32_t n=sizeof(trace_record);
+            _out.write(detail::trace_magic(), std::strlen(detail::trace_magic()));
+            _out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+
+            _writer = boost::thread(boost::bind(&execution_trace::write_blocks, this));
+            _conn = ea.events().end_of_update.connect(boost::bind(&execution_trace::end_of_update, this, _1));
+            _ea.trace(this);
+        }
+
+        //! Destructor; detaches this trace and finishes writing the file.
+        virtual ~execution_trace() {
+            _ea.trace(0);
+            _tls.release();
+            _conn.disconnect();
+            flush();
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                _done = true;
+            }
+            _cv.notify_all();
+            _writer.join();
+            _out.reset();
+            for(typename std::vector<thread_state*>::iterator i=_threads.begin(); i!=_threads.end(); ++i) {
+                delete (*i)->block;
+                delete *i;
+            }
+            for(typename std::vector<block_type*>::iterator i=_free.begin(); i!=_free.end(); ++i) {
+                delete *i;
+            }
+        }
+
+        //! Sets the probability that an organism's time slice is traced.
+        void sample_p(double p) { _sample_p = p; }
+
+        //! Returns the probability that an organism's time slice is traced.
+        double sample_p() const { return _sample_p; }
+
+        //! Only trace the organism with the given ID (and any others so added).
+        void add_organism(boost::uint32_t id) { _organisms.insert(id); }
+
+        //! Only trace organisms born with genome g (and any others so added).
+        void add_genotype(const genome_type& g) {
+            _genotypes.insert(boost::hash_range(g.begin(), g.end()));
+        }
+
+        //! Returns the trace ID of organism ind.
+        static boost::uint32_t organism_id(individual_type& ind) {
+            if(!exists<IND_UNIQUE_NAME>(ind)) {
+                return 0;
+            }
+            return static_cast<boost::uint32_t>(boost::hash<std::string>()(get<IND_UNIQUE_NAME>(ind)));
+        }
+
+        //! Returns the number of records that have been handed to the writer.
+        std::size_t size() {
+            boost::mutex::scoped_lock lock(_mutex);
+            return _records;
+        }
+
+        /*! Called by the hardware on entry to execute(); returns true if the
+         following instructions executed by ind should be traced.
+         */
+        bool begin(individual_type& ind, EA& ea) {
+            thread_state& t=state();
+            if(!_organisms.empty() || !_genotypes.empty()) {
+                boost::uint32_t id=organism_id(ind);
+                bool pass=(_organisms.find(id) != _organisms.end());
+                if(!pass && !_genotypes.empty()) {
+                    // read through a const reference, which leaves the label index valid:
+                    const genome_type& r=static_cast<const individual_type&>(ind).repr();
+                    std::size_t n=std::min(static_cast<std::size_t>(ind.hw().original_size()), r.size());
+                    pass = (_genotypes.find(boost::hash_range(r.begin(), r.begin()+n)) != _genotypes.end());
+                }
+                if(!pass) {
+                    return false;
+                }
+                t.organism = id;
+            } else {
+                t.organism = organism_id(ind);
+            }
+            if((_sample_p < 1.0) && (t.uniform() >= _sample_p)) {
+                return false;
+            }
+            t.update = static_cast<boost::uint32_t>(ea.current_update());
+            return true;
+        }
+
+        //! Called by the hardware just before it executes opcode op.
+        void record(hardware& hw, std::size_t op) {
+            thread_state& t=*_tls;
+            trace_record& r=(*t.block)[t.n++];
+            r.update = t.update;
+            r.organism = t.organism;
+            r.ip = static_cast<boost::uint16_t>(hw.getHeadLocation(hardware::IP));
+            r.opcode = static_cast<boost::uint16_t>(op);
+            for(int i=0; i<hardware::NUM_REGISTERS; ++i) {
+                r.regs[i] = hw.getRegValue(i);
+            }
+            for(int i=0; i<hardware::NUM_HEADS; ++i) {
+                r.heads[i] = static_cast<boost::uint16_t>(hw.getHeadLocation(i));
+            }
+            if(t.n == _block_size) {
+                submit(t);
+            }
+        }
+
+        //! Hands all partially-filled blocks to the writer.
+        void flush() {
+            for(typename std::vector<thread_state*>::iterator i=_threads.begin(); i!=_threads.end(); ++i) {
+                if((*i)->n > 0) {
+                    submit(**i);
+                }
+            }
+        }
+
+    protected:
+        //! Tracing state of a single thread.
+        struct thread_state {
+            thread_state(execution_trace* t, boost::uint32_t seed) : owner(t), block(0), n(0), update(0), organism(0), rng(seed) {
+            }
+
+            //! Returns a uniform random number in [0,1) (xorshift; independent of the EA's RNG).
+            double uniform() {
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                return static_cast<double>(rng) / 4294967296.0;
+            }
+
+            execution_trace* owner; //!< Trace that owns this state.
+            block_type* block; //!< Block being filled.
+            std::size_t n; //!< Number of records in block.
+            boost::uint32_t update; //!< Current update.
+            boost::uint32_t organism; //!< ID of the organism being traced.
+            boost::uint32_t rng; //!< State of the sampling RNG.
+        };
+
+        /*! Called when a thread that has traced exits; its state is kept for
+         reuse by other threads, since schedulers may start new threads
+         every update.
+         */
+        static void retire(thread_state* t) {
+            boost::mutex::scoped_lock lock(t->owner->_mutex);
+            t->owner->_idle.push_back(t);
+        }
+
+        //! Returns the calling thread's state, creating it if needed.
+        thread_state& state() {
+            if(_tls.get() == 0) {
+                boost::mutex::scoped_lock lock(_mutex);
+                thread_state* t=0;
+                if(_idle.empty()) {
+                    t = new thread_state(this, 2463534242u + 7919u*_threads.size());
+                    t->block = take();
+                    t->block->resize(_block_size);
+                    _threads.push_back(t);
+                } else {
+                    t = _idle.back();
+                    _idle.pop_back();
+                }
+                _tls.reset(t);
+            }
+            return *_tls;
+        }
+
+        //! Returns an empty block (the caller must hold _mutex).
+        block_type* take() {
+            if(_free.empty()) {
+                return new block_type(_block_size);
+            }
+            block_type* b=_free.back();
+            _free.pop_back();
+            return b;
+        }
+
+        //! Hands t's block to the writer, and gives t an empty one.
+        void submit(thread_state& t) {
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                t.block->resize(t.n);
+                _records += t.n;
+                _full.push_back(t.block);
+                t.block = take();
+                t.block->resize(_block_size);
+                t.n = 0;
+            }
+            _cv.notify_one();
+        }
+
+        //! Body of the writer thread.
+        void write_blocks() {
+            boost::mutex::scoped_lock lock(_mutex);
+            while(true) {
+                while(_full.empty() && !_done) {
+                    _cv.wait(lock);
+                }
+                if(_full.empty()) {
+                    break;
+                }
+                block_type* b=_full.front();
+                _full.pop_front();
+                lock.unlock();
+                _out.write(reinterpret_cast<const char*>(&(*b)[0]), b->size()*sizeof(trace_record));
+                lock.lock();
+                _free.push_back(b);
+            }
+        }
+
+        //! Flushes at the end of each update.
+        void end_of_update(EA& ea) {
+            flush();
+        }
+
+        EA& _ea; //!< EA being traced.
+        std::size_t _block_size; //!< Records per block.
+        double _sample_p; //!< Sampling probability.
+        boost::unordered_set<boost::uint32_t> _organisms; //!< Organism filter.
+        boost::unordered_set<std::size_t> _genotypes; //!< Genotype filter (genome hashes).
+
+        boost::mutex _mutex; //!< Guards blocks, thread states, and counters.
+        boost::condition_variable _cv; //!< Signals the writer.
+        bool _done; //!< True when the writer should finish.
+        std::size_t _records; //!< Number of records handed to the writer.
+        std::deque<block_type*> _full; //!< Blocks waiting to be written.
+        std::vector<block_type*> _free; //!< Blocks available for reuse.
+        std::vector<thread_state*> _threads; //!< State of every thread that has traced.
+        std::vector<thread_state*> _idle; //!< States of threads that have exited.
+        boost::thread_specific_ptr<thread_state> _tls; //!< State of the calling thread.
+
+        boost::iostreams::filtering_ostream _out; //!< Compressed trace file.
+        boost::thread _writer; //!< Writer thread.
+        boost::signals2::scoped_connection _conn; //!< End of update connection.
+    };
+
+
+    /*! Reads the records of a trace file written by execution_trace.
+     */
+    class trace_reader {
+    public:
+        //! Constructor; opens trace file filename.
+        trace_reader(const std::string& filename) {
+            _in.push(boost::iostreams::gzip_decompressor());
+            _in.push(boost::iostreams::file_source(filename, std::ios_base::in | std::ios_base::binary));
+            std::string magic(std::strlen(detail::trace_magic()), '\0');
+            boost::uint32_t n=0;
+            _in.read(&magic[0], magic.size());
+            _in.read(reinterpret_cast<char*>(&n), sizeof(n));
+            if(!_in || (magic != detail::trace_magic()) || (n != sizeof(trace_record))) {
+                throw fatal_error_exception("trace_reader: " + filename + " is not a trace file");
+            }
+        }
+
+        //! Reads the next record into r; returns false at the end of the trace.
+        bool read(trace_record& r) {
+            _in.read(reinterpret_cast<char*>(&r), sizeof(r));
+            return _in.gcount() == static_cast<std::streamsize>(sizeof(r));
+        }
+
+    protected:
+        boost::iostreams::filtering_istream _in; //!< Compressed trace file.
+    };
+
+
+    /*! Per-instruction statistics gathered from a trace.
+     */
+    struct trace_statistics {
+        //! Constructor.
+        trace_statistics() : records(0) {
+        }
+
+        //! Constructor; gathers statistics from trace file filename.
+        trace_statistics(const std::string& filename) : records(0) {
+            trace_reader in(filename);
+            trace_record r;
+            while(in.read(r)) {
+                add(r);
+            }
+        }
+
+        //! Adds record r to these statistics.
+        void add(const trace_record& r) {
+            if(r.opcode >= executed.size()) {
+                executed.resize(r.opcode+1, 0);
+                organisms.resize(r.opcode+1);
+            }
+            ++executed[r.opcode];
+            organisms[r.opcode].insert(r.organism);
+            ++records;
+        }
+
+        //! Returns the number of distinct organisms that executed opcode op.
+        std::size_t executed_by(std::size_t op) const {
+            return (op < organisms.size()) ? organisms[op].size() : 0;
+        }
+
+        std::size_t records; //!< Total number of records.
+        std::vector<std::size_t> executed; //!< Number of times each opcode was executed.
+        std::vector<boost::unordered_set<boost::uint32_t> > organisms; //!< Organisms that executed each opcode.
+    };
+
+} // ealib
+
+#endif
@@ -112,6 +112,7 @@ namespace ealib {
             
             // these have to be handled carefully:
             population_type population; //!< Population instance.
+            population_type buffer; //!< Back buffer for generational models (not serialized).
             
         private:
             state_type(const state_type&);
@@ -285,9 +286,20 @@ namespace ealib {
         //! Returns the lifecycle object.
         lifecycle_type& lifecycle() { return _state->lifecycle; }
         
+        //! Returns the generational model.
+        generational_model_type& generational_model() { return _state->generational_model; }
+        
         //! Returns this EA's population.
         population_type& population() { return _state->population; }
         
+        /*! Returns this EA's population back buffer.
+         
+         Generational models build the next generation here and then swap it
+         with the population, so that neither buffer is reallocated once the
+         population has reached its steady-state size.
+         */
+        population_type& buffer() { return _state->buffer; }
+        
         //! Returns the size of this EA's population.
         std::size_t size() const { return _state->population.size(); }
         
@@ -0,0 +1,308 @@
+/* cma_es.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_GENERATIONAL_MODELS_CMA_ES_H_
+#define _EA_GENERATIONAL_MODELS_CMA_ES_H_
+
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <ea/generational_models/evolution_strategy.h>
+#include <ea/math/eigen.h>
+#include <ea/metadata.h>
+#include <ea/parallel.h>
+#include <ea/recombination.h>
+
+namespace ealib {
+
+    LIBEA_MD_DECL(CMA_ES_SIGMA, "ea.generational_model.cma_es.sigma", double);
+
+	namespace generational_models {
+
+        //! Tag indicating that CMA-ES should adapt a full covariance matrix.
+        struct full_covarianceS { };
+
+        //! Tag indicating that CMA-ES should adapt only the diagonal of the covariance matrix.
+        struct diagonal_covarianceS { };
+
+		/*! Covariance matrix adaptation evolution strategy (CMA-ES).
+
+         This generational model implements the (\mu/\mu_w, \lambda)-CMA-ES of
+         \cite{hansen2001completely}, for realstring genomes.  Each update
+         samples ES_LAMBDA offspring from a multivariate normal distribution
+         N(m, sigma^2 C), and the ES_MU best offspring are used to update the
+         mean m, the covariance matrix C (rank-one and rank-mu updates) and the
+         step size sigma (cumulative step-size adaptation).  The ES_MU best
+         offspring become the population.
+
+         The eigendecomposition of C, which is needed for sampling, is only
+         recomputed every O(n) generations.  With diagonal_covarianceS, only the
+         diagonal of C is adapted (sep-CMA-ES, \cite{ros2008simple}), which
+         costs O(n) per sample instead of O(n^2), and is meant for
+         high-dimensional genomes.
+
+         The initial mean is the mean of the initial population, and the
+         initial step size is CMA_ES_SIGMA (default 0.5).  The search
+         distribution is not checkpointed; it is re-initialized from the
+         population on load.
+		 */
+		template <typename CovarianceTag=full_covarianceS>
+		struct cma_es {
+            typedef CovarianceTag covariance_tag;
+            typedef boost::numeric::ublas::matrix<double> matrix_type;
+            typedef boost::numeric::ublas::vector<double> vector_type;
+
+            //! Constructor.
+            cma_es() : _n(0), _g(0), _eigen_g(0) {
+            }
+
+            //! Returns the current step size.
+            double sigma() const { return _sigma; }
+
+            //! Returns the current mean of the search distribution.
+            const vector_type& mean() const { return _m; }
+
+            //! Returns the current covariance matrix (diagonal only with diagonal_covarianceS).
+            const matrix_type& covariance() const { return _C; }
+
+            //! Orders (indices of) offspring by decreasing fitness.
+            template <typename Population>
+            struct fitter {
+                fitter(Population& p) : _p(p) { }
+                bool operator()(std::size_t a, std::size_t b) {
+                    return _p[a]->traits().fitness() > _p[b]->traits().fitness();
+                }
+                Population& _p;
+            };
+
+            //! Initialize the search distribution from the given population.
+            template <typename Population, typename EA>
+            void initialize(Population& population, EA& ea) {
+                using namespace boost::numeric::ublas;
+                _n = population.front()->genome().size();
+                _lambda = get<ES_LAMBDA>(ea);
+                _mu = std::min(static_cast<std::size_t>(get<ES_MU>(ea)), _lambda);
+                const double n=static_cast<double>(_n);
+
+                // mean of the population:
+                _m = zero_vector<double>(_n);
+                for(typename Population::iterator i=population.begin(); i!=population.end(); ++i) {
+                    for(std::size_t j=0; j<_n; ++j) {
+                        _m(j) += (*i)->genome()[j];
+                    }
+                }
+                _m /= static_cast<double>(population.size());
+                _sigma = get<CMA_ES_SIGMA>(ea,0.5);
+
+                // recombination weights:
+                _w.resize(_mu);
+                double wsum=0.0, wsq=0.0;
+                for(std::size_t i=0; i<_mu; ++i) {
+                    _w[i] = std::log(_mu+0.5) - std::log(i+1.0);
+                    wsum += _w[i];
+                }
+                for(std::size_t i=0; i<_mu; ++i) {
+                    _w[i] /= wsum;
+                    wsq += _w[i]*_w[i];
+                }
+                _mueff = 1.0/wsq;
+
+                // strategy parameters:
+                _cc = (4.0 + _mueff/n) / (n + 4.0 + 2.0*_mueff/n);
+                _cs = (_mueff + 2.0) / (n + _mueff + 5.0);
+                _c1 = 2.0 / ((n+1.3)*(n+1.3) + _mueff);
+                _cmu = 2.0 * (_mueff - 2.0 + 1.0/_mueff) / ((n+2.0)*(n+2.0) + _mueff);
+                scale_learning_rates(n, covariance_tag());
+                _cmu = std::min(1.0-_c1, _cmu);
+                _damps = 1.0 + 2.0*std::max(0.0, std::sqrt((_mueff-1.0)/(n+1.0)) - 1.0) + _cs;
+                _chin = std::sqrt(n) * (1.0 - 1.0/(4.0*n) + 1.0/(21.0*n*n));
+
+                _pc = zero_vector<double>(_n);
+                _ps = zero_vector<double>(_n);
+                _C = identity_matrix<double>(_n);
+                _B = identity_matrix<double>(_n);
+                _invsqrtC = identity_matrix<double>(_n);
+                _D = scalar_vector<double>(_n, 1.0);
+                _y.assign(_lambda, vector_type(_n));
+                _g = 0;
+                _eigen_g = 0;
+            }
+
+            //! Full covariance: learning rates are unchanged.
+            void scale_learning_rates(double n, full_covarianceS) {
+            }
+
+            //! Diagonal covariance: learning rates are increased by (n+2)/3.
+            void scale_learning_rates(double n, diagonal_covarianceS) {
+                _c1 *= (n+2.0)/3.0;
+                _cmu *= (n+2.0)/3.0;
+            }
+
+            //! Sample y ~ N(0,C) (full covariance).
+            template <typename EA>
+            void sample(vector_type& y, vector_type& z, full_covarianceS, EA& ea) {
+                for(std::size_t j=0; j<_n; ++j) {
+                    z(j) = _D(j) * ea.rng().normal_real(0.0, 1.0);
+                }
+                noalias(y) = prod(_B, z);
+            }
+
+            //! Sample y ~ N(0,C) (diagonal covariance).
+            template <typename EA>
+            void sample(vector_type& y, vector_type& z, diagonal_covarianceS, EA& ea) {
+                for(std::size_t j=0; j<_n; ++j) {
+                    y(j) = _D(j) * ea.rng().normal_real(0.0, 1.0);
+                }
+            }
+
+            //! Returns C^-1/2 * y (full covariance).
+            vector_type whiten(const vector_type& y, full_covarianceS) {
+                return prod(_invsqrtC, y);
+            }
+
+            //! Returns C^-1/2 * y (diagonal covariance).
+            vector_type whiten(const vector_type& y, diagonal_covarianceS) {
+                return element_div(y, _D);
+            }
+
+            //! Rank-one and rank-mu update of C (full covariance).
+            void adapt(double hsig, std::vector<std::size_t>& idx, full_covarianceS) {
+                using namespace boost::numeric::ublas;
+                double a = 1.0 - _c1 - _cmu + _c1*(1.0-hsig)*_cc*(2.0-_cc);
+                _C *= a;
+                noalias(_C) += _c1 * outer_prod(_pc, _pc);
+                for(std::size_t i=0; i<_mu; ++i) {
+                    const vector_type& y=_y[idx[i]];
+                    noalias(_C) += (_cmu*_w[i]) * outer_prod(y, y);
+                }
+
+                // lazy eigendecomposition, every ~1/(10n(c1+cmu)) generations:
+                if((_g - _eigen_g) > (1.0 / ((_c1+_cmu) * _n * 10.0))) {
+                    _eigen_g = _g;
+                    for(std::size_t i=0; i<_n; ++i) {
+                        for(std::size_t j=i+1; j<_n; ++j) {
+                            _C(j,i) = _C(i,j);
+                        }
+                    }
+                    vector_type d;
+                    math::symmetric_eigen(_C, d, _B);
+                    matrix_type S = zero_matrix<double>(_n,_n);
+                    for(std::size_t i=0; i<_n; ++i) {
+                        _D(i) = std::sqrt(std::max(d(i), 1e-300));
+                        S(i,i) = 1.0 / _D(i);
+                    }
+                    matrix_type BS = prod(_B, S);
+                    noalias(_invsqrtC) = prod(BS, trans(_B));
+                }
+            }
+
+            //! Rank-one and rank-mu update of C (diagonal covariance).
+            void adapt(double hsig, std::vector<std::size_t>& idx, diagonal_covarianceS) {
+                double a = 1.0 - _c1 - _cmu + _c1*(1.0-hsig)*_cc*(2.0-_cc);
+                for(std::size_t j=0; j<_n; ++j) {
+                    double c = a*_C(j,j) + _c1*_pc(j)*_pc(j);
+                    for(std::size_t i=0; i<_mu; ++i) {
+                        const vector_type& y=_y[idx[i]];
+                        c += _cmu*_w[i]*y(j)*y(j);
+                    }
+                    _C(j,j) = c;
+                    _D(j) = std::sqrt(std::max(c, 1e-300));
+                }
+            }
+
+			//! Apply this generational model to the EA to produce a single new generation.
+			template <typename Population, typename EA>
+			void operator()(Population& population, EA& ea) {
+                using namespace boost::numeric::ublas;
+                if((_n == 0) || (_n != population.front()->genome().size())) {
+                    initialize(population, ea);
+                }
+                ++_g;
+
+                // sample lambda offspring into the back buffer:
+                Population& offspring = ea.buffer();
+                offspring.clear();
+                vector_type z(_n);
+                typename EA::genome_type x(_n);
+                for(std::size_t k=0; k<_lambda; ++k) {
+                    sample(_y[k], z, covariance_tag(), ea);
+                    for(std::size_t j=0; j<_n; ++j) {
+                        x[j] = _m(j) + _sigma*_y[k](j);
+                    }
+                    offspring.push_back(ea.make_individual(x));
+                }
+                inherits(population, offspring, ea);
+                parallel::calculate_fitness(offspring.begin(), offspring.end(), ea);
+
+                // rank them:
+                std::vector<std::size_t> idx(_lambda);
+                algorithm::iota(idx.begin(), idx.end());
+                std::sort(idx.begin(), idx.end(), fitter<Population>(offspring));
+
+                // move the mean:
+                vector_type yw = zero_vector<double>(_n);
+                for(std::size_t i=0; i<_mu; ++i) {
+                    noalias(yw) += _w[i] * _y[idx[i]];
+                }
+                noalias(_m) += _sigma * yw;
+
+                // evolution paths:
+                _ps = (1.0-_cs)*_ps + std::sqrt(_cs*(2.0-_cs)*_mueff) * whiten(yw, covariance_tag());
+                double psn = norm_2(_ps);
+                double hsig = ((psn / std::sqrt(1.0 - std::pow(1.0-_cs, 2.0*_g)) / _chin) < (1.4 + 2.0/(_n+1.0))) ? 1.0 : 0.0;
+                _pc = (1.0-_cc)*_pc + hsig*std::sqrt(_cc*(2.0-_cc)*_mueff) * yw;
+
+                // covariance and step size:
+                adapt(hsig, idx, covariance_tag());
+                _sigma *= std::exp((_cs/_damps) * (psn/_chin - 1.0));
+
+                // the mu best offspring are the new population:
+                population.clear();
+                for(std::size_t i=0; i<_mu; ++i) {
+                    population.push_back(offspring[idx[i]]);
+                }
+                offspring.clear();
+			}
+
+            std::size_t _n; //!< Dimension of the search space.
+            std::size_t _lambda; //!< Number of offspring per generation.
+            std::size_t _mu; //!< Number of offspring used to update the distribution.
+            std::size_t _g; //!< Generation counter.
+            std::size_t _eigen_g; //!< Generation of the last eigendecomposition.
+            std::vector<double> _w; //!< Recombination weights.
+            double _mueff; //!< Variance effective selection mass.
+            double _cc, _cs, _c1, _cmu, _damps, _chin; //!< Strategy parameters.
+            double _sigma; //!< Step size.
+            vector_type _m; //!< Mean.
+            vector_type _pc; //!< Evolution path for C.
+            vector_type _ps; //!< Evolution path for sigma.
+            vector_type _D; //!< Square roots of the eigenvalues of C.
+            matrix_type _C; //!< Covariance matrix.
+            matrix_type _B; //!< Eigenvectors of C.
+            matrix_type _invsqrtC; //!< C^-1/2.
+            std::vector<vector_type> _y; //!< Sampled steps, y_k ~ N(0,C).
+		};
+
+	} // generational_models
+} // ealib
+
+#endif
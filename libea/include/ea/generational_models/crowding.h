@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <ea/algorithm.h>
 #include <ea/metadata.h>
+#include <ea/parallel.h>
 #include <ea/selection/proportionate.h>
 #include <ea/selection/tournament.h>
 
@@ -40,45 +41,80 @@ namespace ealib {
         template <typename DistanceMeasure=algorithm::hamming_distance_functor>
 		struct deterministic_crowding {
             typedef DistanceMeasure distance_measure_type;
+            
+            /*! Replacement for a range of parent pairs.
+             
+             Pair i is made up of parents population[2i], population[2i+1] and
+             offspring offspring[2i], offspring[2i+1]; each pair only touches
+             its own two slots in the population, so pairs can be processed
+             concurrently.  Fitness must have already been calculated.
+             */
+            template <typename Population, typename EA>
+            struct replacement {
+                replacement(Population& population, Population& offspring, EA& ea)
+                : _population(population), _offspring(offspring), _ea(ea) {
+                }
+                
+                void operator()(std::size_t b, std::size_t e, std::size_t) {
+                    distance_measure_type dmt;
+                    for(std::size_t i=2*b; i<2*e; i+=2) {
+                        typename Population::value_type& p0=_population[i];
+                        typename Population::value_type& p1=_population[i+1];
+                        typename Population::value_type* o0=&_offspring[i];
+                        typename Population::value_type* o1=&_offspring[i+1];
+                        
+                        // which offspring goes w/ which parent?
+                        if(dmt(*p0, **o0, _ea) > dmt(*p0, **o1, _ea)) {
+                            std::swap(o0, o1);
+                        }
+                        
+                        // most fit of each (parent,offspring) pair survives:
+                        if(!(p0->traits().fitness() > (*o0)->traits().fitness())) {
+                            p0 = *o0;
+                        }
+                        if(!(p1->traits().fitness() > (*o1)->traits().fitness())) {
+                            p1 = *o1;
+                        }
+                    }
+                }
+                
+                Population& _population;
+                Population& _offspring;
+                EA& _ea;
+            };
 			
-			//! Apply this generational model to the EA to produce a single new generation.
+			/*! Apply this generational model to the EA to produce a single new generation.
+             
+             Recombination and mutation run on the calling thread (they draw from
+             the EA's RNG and trigger inheritance events).  Fitness evaluation
+             and replacement are split across PARALLEL_THREADS threads, and
+             survivors are written directly into the population.
+             */
 			template <typename Population, typename EA>
 			void operator()(Population& population, EA& ea) {
                 assert(population.size() % 2 == 0);
-                distance_measure_type dmt;
                 
                 // random pairs of parents:
                 std::random_shuffle(population.begin(), population.end(), ea.rng());
                 
-                Population next_gen;
-                for(typename Population::iterator i=population.begin(); i!=population.end(); ) {
-                    Population parents, offspring;
-                    parents.push_back(*i++);
-                    parents.push_back(*i++);
-
-                    recombine(parents, offspring, typename EA::recombination_operator_type(), ea);
-                    mutate(offspring.begin(), offspring.end(), ea);
-                    
-                    // which offspring goes w/ which parent?
-                    if(dmt(*parents[0], *offspring[0], ea) > dmt(*parents[0], *offspring[1], ea)) {
-                        std::swap(offspring[0], offspring[1]);
-                    }
-                    
-                    if(ealib::fitness(*parents[0],ea) > ealib::fitness(*offspring[0],ea)) {
-                        next_gen.push_back(parents[0]);
-                    } else {
-                        next_gen.push_back(offspring[0]);
-                    }
-
-                    if(ealib::fitness(*parents[1],ea) > ealib::fitness(*offspring[1],ea)) {
-                        next_gen.push_back(parents[1]);
-                    } else {
-                        next_gen.push_back(offspring[1]);
-                    }
+                // produce two offspring per pair of parents:
+                Population offspring, parents(2), o;
+                offspring.reserve(population.size());
+                o.reserve(2);
+                for(std::size_t i=0; i<population.size(); i+=2) {
+                    parents[0] = population[i];
+                    parents[1] = population[i+1];
+                    o.clear();
+                    recombine(parents, o, typename EA::recombination_operator_type(), ea);
+                    mutate(o.begin(), o.end(), ea);
+                    offspring.insert(offspring.end(), o.begin(), o.end());
                 }
-
-				// and swap it in for the current population:
-                std::swap(population, next_gen);
+                
+                // evaluate everyone up front, then replace parents in place:
+                parallel::calculate_fitness(population.begin(), population.end(), ea);
+                parallel::calculate_fitness(offspring.begin(), offspring.end(), ea);
+                replacement<Population,EA> r(population, offspring, ea);
+                parallel::for_each_chunk(population.size()/2, parallel::threads(ea), r);
 			}
 		};
 		
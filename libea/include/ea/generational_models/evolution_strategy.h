@@ -22,6 +22,8 @@
 
 #include <ea/access.h>
 #include <ea/generational_models/generational.h>
+#include <ea/recombination.h>
+#include <ea/selection/random.h>
 #include <ea/selection/rank.h>
 
 namespace ealib {
@@ -55,14 +57,17 @@ namespace ealib {
 		template
 		< typename SurvivorTag=commaS
 		, typename RankSelectionStrategy=selection::rank<access::fitness>
+        , typename ParentSelectionStrategy=selection::random< >
 		> struct evolution_strategy {
 			typedef RankSelectionStrategy rank_selection_type;
+            typedef ParentSelectionStrategy parent_selection_type;
 			typedef SurvivorTag survivor_tag_type;
 			
 			//! Perform comma replacement.
 			template <typename Population, typename EA>
-			void replace(Population& population, Population& mutants, Population& survivors, commaS, EA& ea) {
-				select_n<rank_selection_type>(mutants, survivors, get<ES_MU>(ea), ea);
+			void replace(Population& population, Population& mutants, commaS, EA& ea) {
+                population.clear();
+				select_n<rank_selection_type>(mutants, population, get<ES_MU>(ea), ea);
 			}
 			
 			/*! Perform plus replacement.
@@ -71,23 +76,35 @@ namespace ealib {
 			 with equivalent fitness.
 			 */
 			template <typename Population, typename EA>
-			void replace(Population& population, Population& mutants, Population& survivors, plusS, EA& ea) {
-				Population offspring(population);
-				offspring.insert(offspring.end(), mutants.begin(), mutants.end());
-				select_n<rank_selection_type>(offspring, survivors, get<ES_MU>(ea), ea);
+			void replace(Population& population, Population& mutants, plusS, EA& ea) {
+				mutants.insert(mutants.end(), population.begin(), population.end());
+                population.clear();
+				select_n<rank_selection_type>(mutants, population, get<ES_MU>(ea), ea);
 			}
 			
-			//! Apply this generational model to the EA to produce a single new generation.
+			/*! Apply this generational model to the EA to produce a single new generation.
+             
+             Mutants and recombinants are built in the EA's back buffer, and
+             survivors are selected from there back into the population.
+             */
 			template <typename Population, typename EA>
 			void operator()(Population& population, EA& ea) {
-
-				// select and generate the mutants:
-				Population mutants;
-				select_n<rank_selection_type>(population, mutants, get<ES_LAMBDA>(ea), ea);
+                Population& mutants = ea.buffer();
+                mutants.clear();
+                
+				// generate the mutants; each is a copy of a randomly chosen parent:
+                Population p(1), o;
+                const std::size_t lambda=get<ES_LAMBDA>(ea);
+                for(std::size_t i=0; i<lambda; ++i) {
+                    p[0] = *ea.rng().choice(population.begin(), population.end());
+                    o.clear();
+                    recombine(p, o, recombination::asexual(), ea);
+                    mutants.insert(mutants.end(), o.begin(), o.end());
+                }
 				mutate(mutants.begin(), mutants.end(), ea);
 				
 				// select and generate the recombinants:
-				if(get<ES_RHO>(ea) > 0) {
+				if(get<ES_RHO>(ea,0) > 0) {
 					recombine_n(population, mutants,
 								parent_selection_type(get<ES_RHO>(ea),population,ea),
 								typename EA::recombination_operator_type(),
@@ -95,11 +112,8 @@ namespace ealib {
 				}
 				
 				// comma or plus?
-				Population survivors;
-				replace(population, mutants, survivors, survivor_tag_type(), ea);
-				
-				// and swap 'em in for the current population:
-				std::swap(population, survivors);
+				replace(population, mutants, survivor_tag_type(), ea);
+                mutants.clear();
 			}
 		};
 	
@@ -20,6 +20,7 @@
 #ifndef _EA_GENERATIONAL_MODELS_GENERATIONAL_H_
 #define _EA_GENERATIONAL_MODELS_GENERATIONAL_H_
 
+#include <algorithm>
 #include <ea/metadata.h>
 #include <ea/selection.h>
 #include <ea/selection/tournament.h>
@@ -33,6 +34,9 @@ namespace ealib {
          This generational model selects parents from the existing population,
          recombines them to produce offspring, and then the offspring are mutated
          and replace the parents.
+         
+         The next generation is built in the EA's back buffer, which is then
+         swapped with the population.
 		 */
         template
         < typename ParentSelectionStrategy=selection::tournament< >
@@ -44,27 +48,29 @@ namespace ealib {
 			//! Apply this generational model to the EA to produce a single new generation.
 			template <typename Population, typename EA>
 			void operator()(Population& population, EA& ea) {
+                Population& next = ea.buffer();
+                next.clear();
+                
                 // are there survivors?
-                Population survivors;
-                select<survivor_selection_type>(population, survivors, ea);
+                select<survivor_selection_type>(population, next, ea);
+                std::size_t s = next.size();
                 
                 // build the offspring:
-                Population offspring;
-                std::size_t n = population.size() - survivors.size();
-                
-                recombine_n(population, offspring,
+                std::size_t n = population.size() - s;
+                recombine_n(population, next,
                             parent_selection_type(n,population,ea),
                             typename EA::recombination_operator_type(),
                             n, ea);
                 
 				// mutate them:
-				mutate(offspring.begin(), offspring.end(), ea);
+				mutate(next.begin()+s, next.end(), ea);
                 
-                // add the survivors:
-                offspring.insert(offspring.end(), survivors.begin(), survivors.end());
+                // offspring come before survivors:
+                std::rotate(next.begin(), next.begin()+s, next.end());
 				
 				// and swap them in for the current population:
-                std::swap(population, offspring);
+                std::swap(population, next);
+                next.clear();
 			}
 		};
 		
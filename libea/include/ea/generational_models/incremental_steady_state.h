@@ -0,0 +1,175 @@
+/* incremental_steady_state.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_GENERATIONAL_MODELS_INCREMENTAL_STEADY_STATE_H_
+#define _EA_GENERATIONAL_MODELS_INCREMENTAL_STEADY_STATE_H_
+
+#include <cmath>
+#include <vector>
+#include <ea/data_structures/rank_index.h>
+#include <ea/fitness_function.h>
+#include <ea/generational_models/steady_state.h>
+#include <ea/metadata.h>
+#include <ea/parallel.h>
+
+namespace ealib {
+
+    LIBEA_MD_DECL(STEADY_STATE_RANK_PRESSURE, "ea.generational_model.steady_state.rank_pressure", double);
+
+	namespace generational_models {
+
+        namespace detail {
+            //! Value used to rank a maximized fitness.
+            template <typename Fitness>
+            double rank_value(Fitness& f, maximizeS) {
+                return static_cast<double>(f);
+            }
+
+            //! Value used to rank a minimized fitness.
+            template <typename Fitness>
+            double rank_value(Fitness& f, minimizeS) {
+                return -static_cast<double>(f);
+            }
+        } // detail
+
+		/*! Incremental steady-state generational model.
+
+         This is a GENITOR-style steady-state model: for each of
+         STEADY_STATE_LAMBDA births, parents are selected by linear ranking, and
+         each offspring replaces the least fit individual in the population.
+
+         Fitness ranks are kept in a rank_index, so that each birth costs
+         O(log N) instead of a survivor selection over the whole population.
+         STEADY_STATE_RANK_PRESSURE (in [1,2], default 2) is the expected number
+         of offspring of the most fit individual relative to the average.
+
+         The index is rebuilt whenever it no longer matches the population:
+         when the population changes size, when a slot holds a different
+         individual than the one indexed, or when an indexed individual's
+         fitness has been nullified (e.g., by
+         nullifying_reinitialize_fitness_function).  Only slots that are used
+         are checked, so partially nullified populations are re-ranked lazily.
+
+         \warning Only unary fitnesses are supported.
+		 */
+		struct incremental_steady_state {
+
+            //! Returns the rank_index over the population.
+            const rank_index& ranks() const { return _ranks; }
+
+            //! Returns the fitness rank of the individual at slot i (0 is least fit).
+            std::size_t rank(std::size_t i) const { return _ranks.rank(i); }
+
+            //! Returns the slot of the least fit individual.
+            std::size_t worst() const { return _ranks.front(); }
+
+            //! Returns the slot of the most fit individual.
+            std::size_t best() const { return _ranks.back(); }
+
+            //! (Re-)index the population, calculating fitness as needed.
+            template <typename Population, typename EA>
+            void rebuild(Population& population, EA& ea) {
+                parallel::calculate_fitness(population.begin(), population.end(), ea);
+                _ranks.clear();
+                _ptrs.resize(population.size());
+                for(std::size_t i=0; i<population.size(); ++i) {
+                    index(i, population, ea);
+                }
+            }
+
+            //! Index the individual at slot i.
+            template <typename Population, typename EA>
+            void index(std::size_t i, Population& population, EA& ea) {
+                _ptrs[i] = population[i].get();
+                _ranks.update(i, detail::rank_value(ealib::fitness(*population[i],ea),
+                                                    typename EA::fitness_type::direction_tag()));
+            }
+
+            //! Returns true if slot i is still correctly indexed.
+            template <typename Population, typename EA>
+            bool valid(std::size_t i, Population& population, EA& ea) {
+                return (_ptrs[i] == population[i].get()) && has_fitness(*population[i], ea);
+            }
+
+            //! Select a slot via linear ranking with pressure s.
+            template <typename Population, typename EA>
+            std::size_t select_parent(double s, Population& population, EA& ea) {
+                // invert the CDF of the linear ranking distribution, where x is
+                // the (fractional) rank, and 0 is least fit:
+                double u = ea.rng().p();
+                double x = u;
+                if(s > 1.0) {
+                    x = (std::sqrt((2.0-s)*(2.0-s) + 4.0*(s-1.0)*u) - (2.0-s)) / (2.0*(s-1.0));
+                }
+                std::size_t r = std::min(static_cast<std::size_t>(x * _ranks.size()), _ranks.size()-1);
+                std::size_t i = _ranks.nth(r);
+                if(!valid(i, population, ea)) {
+                    rebuild(population, ea);
+                    i = _ranks.nth(r);
+                }
+                return i;
+            }
+
+			//! Apply this generational model to the EA to produce STEADY_STATE_LAMBDA births.
+			template <typename Population, typename EA>
+			void operator()(Population& population, EA& ea) {
+                typedef typename EA::recombination_operator_type recombination_type;
+                if(_ptrs.size() != population.size()) {
+                    rebuild(population, ea);
+                }
+
+                const std::size_t lambda = get<STEADY_STATE_LAMBDA>(ea);
+                const double s = get<STEADY_STATE_RANK_PRESSURE>(ea,2.0);
+                recombination_type rec;
+                Population parents, offspring;
+                parents.reserve(rec.capacity());
+
+                for(std::size_t b=0; b<lambda; ) {
+                    parents.clear();
+                    offspring.clear();
+                    for(std::size_t j=0; j<rec.capacity(); ++j) {
+                        parents.push_back(population[select_parent(s, population, ea)]);
+                    }
+                    recombine(parents, offspring, rec, ea);
+                    if(offspring.empty()) {
+                        break;
+                    }
+                    mutate(offspring.begin(), offspring.end(), ea);
+
+                    // each offspring replaces the least fit individual:
+                    for(typename Population::iterator k=offspring.begin(); (k!=offspring.end()) && (b<lambda); ++k, ++b) {
+                        std::size_t w = _ranks.front();
+                        if(!valid(w, population, ea)) {
+                            rebuild(population, ea);
+                            w = _ranks.front();
+                        }
+                        population[w] = *k;
+                        index(w, population, ea);
+                    }
+                }
+			}
+
+            rank_index _ranks; //!< Fitness ranks of the population.
+            std::vector<const void*> _ptrs; //!< Individual indexed at each slot.
+		};
+
+	} // generational_models
+} // ealib
+
+#endif
@@ -40,6 +40,9 @@ namespace ealib {
          by Patrick Moran.  The only difference is that we make use of a replacement
          rate, as opposed to replacing a single individual at a time (for speed).
          
+         Like steady_state, survivors are selected into the EA's back buffer,
+         and the population is reused as scratch space for the offspring.
+         
          \warning Fitness can not be negative.
 		 */
         template
@@ -56,14 +59,16 @@ namespace ealib {
                 std::size_t n = static_cast<std::size_t>((1.0 - get<MORAN_REPLACEMENT_RATE_P>(ea)) * get<POPULATION_SIZE>(ea));
                 
                 // select individuals for survival:
-				Population survivors;
+				Population& survivors = ea.buffer();
+                survivors.clear();
                 select_n<survivor_selection_type>(population, survivors, n, ea);
                 
                 // how many offspring?
                 n = get<POPULATION_SIZE>(ea) - survivors.size();
 				
                 // recombine the survivors to produce offspring:
-                Population offspring;
+                Population& offspring = population;
+                offspring.clear();
                 recombine_n(survivors, offspring,
                             parent_selection_type(n,survivors,ea),
                             typename EA::recombination_operator_type(),
@@ -77,6 +82,7 @@ namespace ealib {
                 
 				// and swap 'em in for the current population:
                 std::swap(population, survivors);
+                survivors.clear();
             }
 		};
 		
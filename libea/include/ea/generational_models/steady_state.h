@@ -41,6 +41,10 @@ namespace ealib {
 		 for inclusion in the next generation.
          
          \param lambda is the number of offspring during 1 update (~"generation").
+         
+         Survivors are selected into the EA's back buffer, and the (now unused)
+         population is reused as scratch space for the offspring before the
+         buffers are swapped.
 		 */
         template <
         typename ParentSelectionStrategy=selection::proportionate< >,
@@ -56,11 +60,13 @@ namespace ealib {
                 unsigned int n = get<POPULATION_SIZE>(ea) - get<STEADY_STATE_LAMBDA>(ea);
                 
                 // select individuals for survival:
-				Population survivors;
+				Population& survivors = ea.buffer();
+                survivors.clear();
                 select_n<survivor_selection_type>(population, survivors, n, ea);
                 
                 // recombine the survivors to produce offspring:
-                Population offspring;
+                Population& offspring = population;
+                offspring.clear();
                 recombine_n(survivors, offspring,
                             parent_selection_type(n,survivors,ea),
                             typename EA::recombination_operator_type(),
@@ -74,6 +80,7 @@ namespace ealib {
                 
 				// and swap 'em in for the current population:
                 std::swap(population, survivors);
+                survivors.clear();
 			}
 		};
 		
@@ -22,8 +22,13 @@
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/array_wrapper.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_same.hpp>
 #include <sstream>
 #include <ea/metadata.h>
+#include <ea/checkpoint.h>
 #include <ea/data_structures/circular_vector.h>
 
 
@@ -64,6 +69,48 @@ namespace ealib {
 		// These enable a more compact serialization of the genome.
 		template<class Archive>
 		void save(Archive & ar, const unsigned int version) const {
+            save(ar, packed<Archive>());
+        }
+		
+		template<class Archive>
+		void load(Archive & ar, const unsigned int version) {
+            load(ar, packed<Archive>());
+        }
+		BOOST_SERIALIZATION_SPLIT_MEMBER();
+        
+    protected:
+        /*! Genomes of numbers are written to binary checkpoints as packed
+         arrays, and to all other archives as a string.
+         */
+        template <class Archive>
+        struct packed : boost::mpl::bool_<checkpoint::columnar<Archive>::value
+        && boost::is_arithmetic<T>::value && !boost::is_same<T,bool>::value> {
+        };
+        
+		//! Save this genome as a packed array.
+		template<class Archive>
+		void save(Archive & ar, boost::mpl::true_) const {
+            std::size_t size=base_type::size();
+            ar & BOOST_SERIALIZATION_NVP(size);
+            if(size > 0) {
+                ar & boost::serialization::make_nvp("genome", boost::serialization::make_array(&base_type::front(), size));
+            }
+        }
+        
+		//! Load this genome from a packed array.
+		template<class Archive>
+		void load(Archive & ar, boost::mpl::true_) {
+            std::size_t size=0;
+            ar & BOOST_SERIALIZATION_NVP(size);
+            base_type::resize(size);
+            if(size > 0) {
+                ar & boost::serialization::make_nvp("genome", boost::serialization::make_array(&base_type::front(), size));
+            }
+        }
+        
+		//! Save this genome as a string.
+		template<class Archive>
+		void save(Archive & ar, boost::mpl::false_) const {
 			std::ostringstream out;
 			out << base_type::size();
 			for(typename base_type::const_iterator i=base_type::begin(); i!=base_type::end(); ++i) {
@@ -73,8 +120,9 @@ namespace ealib {
 			ar & BOOST_SERIALIZATION_NVP(genome);
 		}
 		
+		//! Load this genome from a string.
 		template<class Archive>
-		void load(Archive & ar, const unsigned int version) {
+		void load(Archive & ar, boost::mpl::false_) {
 			std::string genome;
 			ar & BOOST_SERIALIZATION_NVP(genome);
 			std::istringstream in(genome);
@@ -87,7 +135,6 @@ namespace ealib {
                 base_type::push_back(t);
 			}
 		}
-		BOOST_SERIALIZATION_SPLIT_MEMBER();		
 	};
 	
 } // ea
@@ -0,0 +1,96 @@
+/* eigen.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_MATH_EIGEN_H_
+#define _EA_MATH_EIGEN_H_
+
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+#include <cmath>
+
+namespace ealib {
+    namespace math {
+
+        /*! Eigendecomposition of the real symmetric matrix A via the cyclic
+         Jacobi method.
+
+         On return, d holds the eigenvalues of A, and column i of V holds the
+         eigenvector for d(i).  A is not modified.  Convergence is quadratic
+         once off-diagonal elements are small; max_sweeps bounds the work for
+         badly-conditioned inputs.
+         */
+        template <typename Matrix, typename Vector>
+        void symmetric_eigen(const Matrix& A, Vector& d, Matrix& V, std::size_t max_sweeps=50) {
+            const std::size_t n=A.size1();
+            Matrix a(A);
+            V = boost::numeric::ublas::identity_matrix<double>(n);
+            d.resize(n);
+
+            for(std::size_t sweep=0; sweep<max_sweeps; ++sweep) {
+                // stop once the off-diagonal elements are negligible:
+                double off=0.0, diag=0.0;
+                for(std::size_t p=0; p<n; ++p) {
+                    diag += a(p,p)*a(p,p);
+                    for(std::size_t q=p+1; q<n; ++q) {
+                        off += a(p,q)*a(p,q);
+                    }
+                }
+                if(off <= 1e-30*diag) {
+                    break;
+                }
+
+                for(std::size_t p=0; p<n; ++p) {
+                    for(std::size_t q=p+1; q<n; ++q) {
+                        if(a(p,q) == 0.0) {
+                            continue;
+                        }
+                        // rotation that zeroes a(p,q):
+                        double theta = (a(q,q) - a(p,p)) / (2.0*a(p,q));
+                        double t = ((theta >= 0.0) ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta*theta + 1.0));
+                        double c = 1.0 / std::sqrt(t*t + 1.0);
+                        double s = t*c;
+
+                        for(std::size_t k=0; k<n; ++k) {
+                            double akp=a(k,p), akq=a(k,q);
+                            a(k,p) = c*akp - s*akq;
+                            a(k,q) = s*akp + c*akq;
+                        }
+                        for(std::size_t k=0; k<n; ++k) {
+                            double apk=a(p,k), aqk=a(q,k);
+                            a(p,k) = c*apk - s*aqk;
+                            a(q,k) = s*apk + c*aqk;
+                        }
+                        for(std::size_t k=0; k<n; ++k) {
+                            double vkp=V(k,p), vkq=V(k,q);
+                            V(k,p) = c*vkp - s*vkq;
+                            V(k,q) = s*vkp + c*vkq;
+                        }
+                    }
+                }
+            }
+
+            for(std::size_t i=0; i<n; ++i) {
+                d(i) = a(i,i);
+            }
+        }
+
+    } // math
+} // ealib
+
+#endif
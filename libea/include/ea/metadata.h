@@ -226,6 +226,17 @@ namespace ealib {
 			return true;
 		}
 		
+		//! Erase meta-data with key k, if it exists.
+		void erase(const std::string& k) {
+			_strings.erase(k);
+			_values.erase(k);
+		}
+		
+		//! Returns true if there is no meta-data.
+		bool empty() const {
+			return _strings.empty() && _values.empty();
+		}
+		
 		//! Clear all meta data.
 		void clear() {
 			_strings.clear();
@@ -22,6 +22,8 @@
 
 #include <boost/serialization/nvp.hpp>
 #include <algorithm>
+#include <limits>
+#include <vector>
 
 #include <ea/algorithm.h>
 #include <ea/individual.h>
@@ -72,6 +74,17 @@ namespace ealib {
     };
     
     
+    //! Plain (rank, distance, index) tuple that the crowding comparison operator can sort.
+    struct crowding_key {
+        crowding_key() : rank(0), distance(0.0), index(0) {
+        }
+        crowding_key(int r, double d, std::size_t i) : rank(r), distance(d), index(i) {
+        }
+        int rank; //!< Rank of the individual.
+        double distance; //!< Crowding distance of the individual.
+        std::size_t index; //!< Index of the individual in its front.
+    };
+    
     /*! Crowding comparison operator, <_n.
      
      Read: "a <_n b" as "b is better than a"
@@ -92,6 +105,13 @@ namespace ealib {
             || ((_acc(*a,_ea).rank == _acc(*b,_ea).rank) && (_acc(*a,_ea).distance < _acc(*b,_ea).distance)); // lesser distances are worse
         }
         
+        //! Returns true if a <_n b, false otherwise (ties are broken by index; greater indices are worse).
+        bool operator()(const crowding_key& a, const crowding_key& b) const {
+            return (a.rank > b.rank)
+            || ((a.rank == b.rank) && (a.distance < b.distance))
+            || ((a.rank == b.rank) && (a.distance == b.distance) && (a.index > b.index));
+        }
+        
         AttributeAccessor _acc;
         EA& _ea; //!< Reference to the EA in which the individuals to be compared reside.
     };
@@ -113,27 +133,70 @@ namespace ealib {
                 return algorithm::dominates(ealib::fitness(a,ea), ealib::fitness(b,ea));
             }
             
-            //! Calculates crowding distance among individuals in population I.
+            /*! Calculates crowding distance among individuals in population I.
+             
+             Objectives are copied once into a contiguous objective-major matrix,
+             and each objective is then sorted by index, so the fitness accessor is
+             not called on every comparison.  I is not reordered.
+             */
             template <typename Population, typename EA>
             void crowding_distance(Population& I, EA& ea) {
-                for(typename Population::iterator i=I.begin(); i!=I.end(); ++i) {
-                    (*i)->traits().distance = 0.0;
+                const std::size_t l = I.size();
+                const std::size_t M = ea.fitness_function().size();
+                if(l == 0) {
+                    return;
                 }
                 
-                std::size_t M = ea.fitness_function().size();
+                // X[m*l+i] is objective m of individual i:
+                _X.resize(M*l);
+                for(std::size_t i=0; i<l; ++i) {
+                    typename EA::fitness_type& f=ealib::fitness(*I[i],ea);
+                    std::size_t m=0;
+                    for(typename EA::fitness_type::value_type::iterator j=f.begin(); (j!=f.end()) && (m<M); ++j, ++m) {
+                        _X[m*l+i] = static_cast<double>(*j);
+                    }
+                }
+                
+                _D.assign(l, 0.0);
+                _idx.resize(l);
+                _s.resize(l);
+                _g.resize(l);
                 
                 for(std::size_t m=0; m<M; ++m) {
-                    std::sort(I.begin(), I.end(), comparators::objective<EA>(m,ea));
+                    const double* x=&_X[m*l];
+                    algorithm::iota(_idx.begin(), _idx.end());
+                    std::sort(_idx.begin(), _idx.end(), objective_order(x));
                     
-                    (*I.begin())->traits().distance = std::numeric_limits<double>::max();
-                    (*I.rbegin())->traits().distance = std::numeric_limits<double>::max();
-                    
-                    for(std::size_t i=1; i<(I.size()-1); ++i) {
-                        I[i]->traits().distance += (ealib::fitness(*I[i+1],ea)[m] - ealib::fitness(*I[i-1],ea)[m]) / ea.fitness_function().range(m);
+                    // gather the sorted objective, and compute the gaps in one
+                    // pass over contiguous memory:
+                    for(std::size_t i=0; i<l; ++i) {
+                        _s[i] = x[_idx[i]];
+                    }
+                    const double r = 1.0 / ea.fitness_function().range(m);
+                    for(std::size_t i=1; (i+1)<l; ++i) {
+                        _g[i] = (_s[i+1] - _s[i-1]) * r;
                     }
+                    for(std::size_t i=1; (i+1)<l; ++i) {
+                        _D[_idx[i]] += _g[i];
+                    }
+                    _D[_idx[0]] = std::numeric_limits<double>::max();
+                    _D[_idx[l-1]] = std::numeric_limits<double>::max();
+                }
+                
+                for(std::size_t i=0; i<l; ++i) {
+                    I[i]->traits().distance = _D[i];
                 }
             }
             
+            //! Orders indices by the objective values they refer to.
+            struct objective_order {
+                objective_order(const double* x) : _x(x) { }
+                bool operator()(std::size_t a, std::size_t b) const {
+                    return (_x[a] < _x[b]) || ((_x[a] == _x[b]) && (a < b));
+                }
+                const double* _x;
+            };
+            
             //! Sort at least n individuals from population P into fronts F.
             template <typename Population, typename PopulationMap, typename EA>
             void nondominated_sort(Population& P, std::size_t n, PopulationMap& F, EA& ea) {
@@ -183,14 +246,31 @@ namespace ealib {
                 std::map<int,Population> F;
                 nondominated_sort(src, n, F, ea);
 
+                crowding_comparator<access::traits,EA> cmp(ea);
                 for(std::size_t i=0; (i<F.size()) && (dst.size()<n); ++i) {
-                    crowding_distance(F[i],ea);
-                    std::sort(F[i].begin(), F[i].end(), crowding_comparator<access::traits,EA>(ea));
-                    dst.insert(dst.end(),
-                               F[i].rbegin(), // start from **greatest** crowding distance
-                               F[i].rbegin() + std::min(F[i].size(), (n-dst.size())));
+                    Population& Fi=F[i];
+                    crowding_distance(Fi,ea);
+                    
+                    _keys.resize(Fi.size());
+                    for(std::size_t j=0; j<Fi.size(); ++j) {
+                        _keys[j] = crowding_key(Fi[j]->traits().rank, Fi[j]->traits().distance, j);
+                    }
+                    std::sort(_keys.begin(), _keys.end(), cmp);
+                    
+                    // start from **greatest** crowding distance:
+                    std::size_t k=std::min(Fi.size(), (n-dst.size()));
+                    for(std::vector<crowding_key>::reverse_iterator j=_keys.rbegin(); k>0; ++j, --k) {
+                        dst.push_back(Fi[j->index]);
+                    }
                 }
             }
+            
+            std::vector<double> _X; //!< Objective matrix (objective-major).
+            std::vector<double> _D; //!< Crowding distances.
+            std::vector<double> _s; //!< Sorted values of a single objective.
+            std::vector<double> _g; //!< Normalized gaps of a single objective.
+            std::vector<std::size_t> _idx; //!< Index sort of a single objective.
+            std::vector<crowding_key> _keys; //!< Crowding keys of a single front.
         };
     }
     
@@ -267,11 +347,14 @@ namespace ealib {
 			void operator()(Population& population, EA& ea) {
                 std::size_t n = get<POPULATION_SIZE>(ea)/2;
                 
-                // select the parents via nondominated sorting:
-                Population parents;
+                // select the parents via nondominated sorting into the back buffer:
+                Population& parents = ea.buffer();
+                parents.clear();
                 select_n<selection::nsga2>(population, parents, n, ea);
                 
-                Population offspring;
+                // the offspring reuse the current population's storage:
+                Population& offspring = population;
+                offspring.clear();
                 recombine_n(parents, offspring,
                             selection::rank<access::traits,crowding_comparator>(n,parents,ea),
                             typename EA::recombination_operator_type(),
@@ -286,6 +369,7 @@ namespace ealib {
                 
                 // and swap 'em in:
                 std::swap(population, parents);
+                parents.clear();
 			}
 		};
 		
@@ -0,0 +1,232 @@
+/* parallel.h
+ *
+ * This file is part of EALib.
+ *
+ * Copyright 2014 David B. Knoester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EA_PARALLEL_H_
+#define _EA_PARALLEL_H_
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_set.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <ea/fitness_function.h>
+#include <ea/metadata.h>
+
+namespace ealib {
+
+    LIBEA_MD_DECL(PARALLEL_THREADS, "ea.parallel.threads", unsigned int);
+
+    /*! Support for splitting work across threads.
+
+     Everything in here is built so that results depend only on the size of the
+     work and the number of chunks it is split into, never on thread scheduling.
+     In particular, any randomness needed by a chunk must be drawn up front (on
+     the calling thread) from the EA's RNG.
+
+     The number of threads is controlled by PARALLEL_THREADS, which defaults to
+     1 (i.e., everything runs on the calling thread).
+     */
+    namespace parallel {
+
+        /*! Returns the number of threads that should be used by this EA.
+
+         This does not add PARALLEL_THREADS to the EA's metadata if it isn't
+         already there, so that checkpoints are unaffected.
+         */
+        template <typename EA>
+        std::size_t threads(EA& ea) {
+            if(!exists<PARALLEL_THREADS>(ea)) {
+                return 1;
+            }
+            return std::max(get<PARALLEL_THREADS>(ea), 1u);
+        }
+
+        //! Returns the bounds [b,e) of chunk i when [0,n) is split into k chunks.
+        inline std::pair<std::size_t,std::size_t> chunk(std::size_t i, std::size_t k, std::size_t n) {
+            std::size_t q=n/k, r=n%k;
+            std::size_t b = i*q + std::min(i,r);
+            return std::make_pair(b, b + q + ((i<r) ? 1 : 0));
+        }
+
+        /*! Split [0,n) into (at most) k contiguous chunks, and call f(b,e,i) for
+         each chunk [b,e) with chunk index i.
+
+         Chunk 0 runs on the calling thread; the others each run on their own
+         thread.  f must be safe to call concurrently on disjoint ranges.
+         */
+        template <typename Function>
+        void for_each_chunk(std::size_t n, std::size_t k, Function& f) {
+            k = std::min(k,n);
+            if(k <= 1) {
+                if(n > 0) {
+                    f(0, n, 0);
+                }
+                return;
+            }
+
+            boost::thread_group workers;
+            for(std::size_t i=1; i<k; ++i) {
+                std::pair<std::size_t,std::size_t> c=chunk(i,k,n);
+                workers.create_thread(boost::bind<void>(boost::ref(f), c.first, c.second, i));
+            }
+            std::pair<std::size_t,std::size_t> c=chunk(0,k,n);
+            f(c.first, c.second, 0);
+            workers.join_all();
+        }
+
+        namespace detail {
+            //! Thread-specific values that are owned elsewhere are not deleted.
+            template <typename T>
+            void no_cleanup(T*) {
+            }
+        } // detail
+
+        /*! Returns the index of the partition (e.g., tile) of the world that the
+         calling thread is working on, if any.
+
+         Shared state that can't be split by space, such as the level of a
+         limited resource, uses this to give each partition its own copy; the
+         result then depends only on which partition did the work, not on
+         which thread ran it.  The caller that sets the index owns it.
+         */
+        inline boost::thread_specific_ptr<std::size_t>& current_partition() {
+            static boost::thread_specific_ptr<std::size_t> p(&detail::no_cleanup<std::size_t>);
+            return p;
+        }
+
+        /*! Draw k seeds from the EA's RNG, one per chunk.
+
+         These are used to build per-chunk RNG streams; seeds are always drawn
+         in chunk order, so results are reproducible for a given seed and chunk
+         count.
+         */
+        template <typename EA>
+        void seeds(std::size_t k, std::vector<int>& s, EA& ea) {
+            s.resize(k);
+            for(std::size_t i=0; i<k; ++i) {
+                s[i] = ea.rng().seed();
+            }
+        }
+
+        namespace detail {
+
+            //! Evaluates fitness for a list of individuals (deterministic).
+            template <typename EA>
+            struct fitness_chunk {
+                typedef std::vector<typename EA::individual_type*> work_type;
+
+                fitness_chunk(work_type& w, std::vector<int>& s, EA& ea) : _w(w), _s(s), _ea(ea) {
+                }
+
+                void operator()(std::size_t b, std::size_t e, std::size_t) {
+                    for( ; b!=e; ++b) {
+                        eval(*_w[b], b, typename EA::fitness_function_type::stability_tag());
+                    }
+                }
+
+                void eval(typename EA::individual_type& ind, std::size_t, deterministicS) {
+                    ind.traits().fitness() = _ea.fitness_function()(ind, _ea);
+                }
+
+                void eval(typename EA::individual_type& ind, std::size_t i, stochasticS) {
+                    typename EA::rng_type rng(_s[i]);
+                    ind.traits().fitness() = _ea.fitness_function()(ind, rng, _ea);
+                }
+
+                work_type& _w;
+                std::vector<int>& _s;
+                EA& _ea;
+            };
+
+            //! Constant fitness: only individuals without fitness are evaluated.
+            template <typename Individual>
+            bool needs_fitness(Individual& ind, constantS) {
+                return ind.traits().fitness().is_null();
+            }
+
+            //! Nonstationary fitness: all individuals are evaluated.
+            template <typename Individual>
+            bool needs_fitness(Individual& ind, nonstationaryS) {
+                return true;
+            }
+
+            //! Deterministic fitness functions don't need seeds.
+            template <typename EA>
+            void fitness_seeds(std::vector<typename EA::individual_type*>& w, std::vector<int>& s, deterministicS, EA& ea) {
+            }
+
+            //! Stochastic fitness functions get a seed per individual.
+            template <typename EA>
+            void fitness_seeds(std::vector<typename EA::individual_type*>& w, std::vector<int>& s, stochasticS, EA& ea) {
+                seeds(w.size(), s, ea);
+                for(std::size_t i=0; i<w.size(); ++i) {
+                    put<FF_RNG_SEED>(s[i], *w[i]);
+                }
+            }
+
+        } // detail
+
+        /*! Calculate fitness for the individuals in the population range [f,l),
+         using PARALLEL_THREADS threads.
+
+         This has the same effect as ealib::calculate_fitness(f,l,ea): fitness
+         function initialization, seed generation (for stochastic fitness
+         functions) and fitness_evaluated events all happen on the calling
+         thread, in population order.  Only the calls to the fitness function
+         itself are run concurrently, so the fitness function must be safe to
+         call from multiple threads (e.g., it must not lazily touch EA metadata).
+
+         Individuals that appear more than once in [f,l) are only evaluated once.
+         */
+        template <typename ForwardIterator, typename EA>
+        void calculate_fitness(ForwardIterator f, ForwardIterator l, EA& ea) {
+            typedef typename EA::individual_type individual_type;
+            typedef typename EA::fitness_function_type fitness_function_type;
+
+            ealib::detail::initialize_fitness_function(ea);
+
+            std::vector<individual_type*> w;
+            boost::unordered_set<individual_type*> seen;
+            for( ; f!=l; ++f) {
+                individual_type* p = &(**f);
+                if(detail::needs_fitness(*p, typename fitness_function_type::constant_tag())
+                   && seen.insert(p).second) {
+                    w.push_back(p);
+                }
+            }
+
+            std::vector<int> s;
+            detail::fitness_seeds(w, s, typename fitness_function_type::stability_tag(), ea);
+
+            detail::fitness_chunk<EA> fc(w, s, ea);
+            for_each_chunk(w.size(), threads(ea), fc);
+
+            for(typename std::vector<individual_type*>::iterator i=w.begin(); i!=w.end(); ++i) {
+                ea.events().fitness_evaluated(**i, ea);
+            }
+        }
+
+    } // parallel
+} // ealib
+
+#endif
@@ -54,12 +54,16 @@ namespace ealib {
         inherits(parents, offspring, ea);
     }
     
-    /*! Recombine parents selected from the given population to generate n offspring.
+    /*! Recombine parents selected from the given population to generate n offspring,
+     which are appended to offspring.
      */
     template <typename Population, typename Selector, typename Recombinator, typename EA>
     void recombine_n(Population& population, Population& offspring, Selector sel, Recombinator rec, std::size_t n, EA& ea) {
+        n += offspring.size();
+        Population p, o; // parents, offspring
         while(offspring.size() < n) {
-            Population p, o; // parents, offspring
+            p.clear();
+            o.clear();
             sel(population, p, rec.capacity(), ea); // select parents
             rec(p, o, ea); // recombine parents to produce offspring
             inherits(p, o, ea);
@@ -18,7 +18,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "test.h"
+#include <boost/thread/thread.hpp>
 #include <ea/digital_evolution.h>
+#include <ea/digital_evolution/groups.h>
+#include <ea/datafiles/genotypes.h>
+#include <ea/metapopulation.h>
 
 
 struct test_lifecycle : default_lifecycle {
@@ -101,6 +105,83 @@ BOOST_AUTO_TEST_CASE(test_resources) {
     BOOST_CHECK_CLOSE(0.0721839, r->level(position_type(1,0)), 0.001);
 }
 
+BOOST_AUTO_TEST_CASE(test_lazy_resources) {
+    ea_type ea(build_md());
+    ea_type::resource_ptr_type r = make_resource("resA", 2.0, 0.5, 0.1, 0.1, ea);
+    ea_type::resource_ptr_type s = make_resource("resB", 0.0, 0.5, 1.0, 0.75, 0.1, ea);
+
+    // levels are exactly what eager updates would have given, no matter when
+    // they are read:
+    double level=2.0, top=0.5;
+    for(std::size_t k=0; k<20; ++k) {
+        ea.resources().update(1.0);
+        level = std::max(0.0, level + 1.0 * (0.5 - (0.1 * level)));
+        top += 1.0;
+        if((k == 6) || (k == 19)) {
+            BOOST_CHECK_EQUAL(r->level(position_type(0,0)), level);
+            BOOST_CHECK_EQUAL(s->level(position_type(3,9)), top);
+            BOOST_CHECK_EQUAL(s->level(position_type(3,5)), 0.5);
+            BOOST_CHECK_EQUAL(s->level(position_type(3,0)), 0.0);
+        }
+    }
+    BOOST_CHECK_EQUAL(s->level(position_type(4,9)), top);
+
+    s->reset();
+    ea.resources().update(1.0);
+    BOOST_CHECK_EQUAL(s->level(position_type(4,9)), 1.5);
+    
+    // contributions go to the contributor's cell:
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    ea_type::individual_type& ind=*ea.population()[0];
+    double before=s->level(ind.position());
+    s->contribute(1.0, ind);
+    BOOST_CHECK_EQUAL(s->level(ind.position()), before + 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_diffusion_grid) {
+    // odd sizes, so that row padding and column tiles are both exercised:
+    const std::size_t n=37, m=1030;
+    const double k=0.1;
+    default_rng_type rng(1);
+    std::vector<double> R(n*m), T(n*m);
+    diffusion_grid g1, g4;
+    g1.resize(n,m);
+    g4.resize(n,m);
+    for(std::size_t i=0; i<n; ++i) {
+        for(std::size_t j=0; j<m; ++j) {
+            R[i*m+j] = T[i*m+j] = g1(i,j) = g4(i,j) = rng.uniform_real(0.0,10.0);
+        }
+    }
+    
+    for(std::size_t s=0; s<5; ++s) {
+        // reference explicit scheme:
+        for(std::size_t i=1; i<n-1; ++i) {
+            for(std::size_t j=1; j<m-1; ++j) {
+                double uxx = R[(i+1)*m+j] - 2*R[i*m+j] + R[(i-1)*m+j];
+                double uyy = R[i*m+j+1] - 2*R[i*m+j] + R[i*m+j-1];
+                T[i*m+j] = R[i*m+j] + k * (uxx+uyy);
+            }
+        }
+        R.swap(T);
+        
+        diffusion_pass p1;
+        p1.add(g1, k);
+        p1.run();
+        diffusion_pass p4(4,0);
+        p4.add(g4, k);
+        p4.run();
+    }
+    
+    // results are identical, not just close:
+    bool same=true;
+    for(std::size_t i=0; i<n; ++i) {
+        for(std::size_t j=0; j<m; ++j) {
+            same = same && (g1(i,j) == R[i*m+j]) && (g4(i,j) == R[i*m+j]);
+        }
+    }
+    BOOST_CHECK(same);
+}
+
 BOOST_AUTO_TEST_CASE(test_avida_hardware) {
     ea_type ea(build_md());
     ea_type::isa_type& isa=ea.isa();
@@ -140,6 +221,385 @@ BOOST_AUTO_TEST_CASE(test_avida_hardware) {
     BOOST_CHECK_EQUAL(c.second, 3);
 }
 
+BOOST_AUTO_TEST_CASE(test_avida_label_search) {
+    ea_type ea(build_md());
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    
+    ea_type::individual_ptr_type p = ea.population()[0];
+    ea_type::hardware_type& hw = p->hw();
+    
+    // the indexed label search agrees with a full scan, including labels that
+    // wrap around memory and memory that is mostly (or all) nops:
+    for(int t=0; t<200; ++t) {
+        ea_type::genome_type& r = p->repr();
+        r.resize(ea.rng()(1,60));
+        unsigned int nops = (t % 10 == 0) ? 3 : 6;
+        for(std::size_t i=0; i<r.size(); ++i) {
+            r[i] = ea.rng()(nops);
+        }
+        hardware::label_stack label;
+        std::size_t n = ea.rng()(1,5);
+        for(std::size_t i=0; i<n; ++i) {
+            label.push_back(ea.rng()(3));
+        }
+        for(int ip=0; ip<static_cast<int>(r.size()); ++ip) {
+            hw.setHeadLocation(hardware::IP, ip);
+            BOOST_CHECK_EQUAL(hw.findLabel(label), hw.scanLabel(label));
+        }
+        
+        // writes through setInstruction keep the index current:
+        int pos = ea.rng()(r.size());
+        hw.setInstruction(pos, ea.rng()(nops));
+        hw.setHeadLocation(hardware::IP, 0);
+        BOOST_CHECK_EQUAL(hw.findLabel(label), hw.scanLabel(label));
+        
+        // as do writes through repr() and resizes:
+        p->repr()[ea.rng()(r.size())] = ea.rng()(nops);
+        BOOST_CHECK_EQUAL(hw.findLabel(label), hw.scanLabel(label));
+        hw.resize(r.size() / 2 + 1);
+        BOOST_CHECK_EQUAL(hw.findLabel(label), hw.scanLabel(label));
+        
+        // copies take the index with them:
+        ea_type::hardware_type hw2(hw);
+        BOOST_CHECK_EQUAL(hw2.findLabel(label), hw.scanLabel(label));
+        hw2.setInstruction(0, hardware::NOP_X);
+        BOOST_CHECK_EQUAL(hw2.findLabel(label), hw2.scanLabel(label));
+    }
+    
+    // labels longer than the label stack are truncated:
+    hw.clearLabelStack();
+    for(int i=0; i<2*hardware::MAX_LABEL_SIZE; ++i) {
+        hw.pushLabelStack(hardware::NOP_A);
+    }
+    BOOST_CHECK_EQUAL(hw.getLabelStackSize(), static_cast<std::size_t>(hardware::MAX_LABEL_SIZE));
+}
+
+BOOST_AUTO_TEST_CASE(test_avida_hardware_state) {
+    ea_type ea(build_md());
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    ea_type::hardware_type& hw = ea.population()[0]->hw();
+    
+    // the data stack keeps only the most recent values:
+    for(int i=0; i<hardware::MAX_STACK_SIZE+5; ++i) {
+        hw.push_stack(i);
+    }
+    // only the most recent messages are kept:
+    for(int i=0; i<hardware::MAX_MSGS_QUEUED+5; ++i) {
+        hw.deposit_message(i, i);
+    }
+    BOOST_CHECK_EQUAL(hw.msgs_queued(), static_cast<std::size_t>(hardware::MAX_MSGS_QUEUED));
+    
+    // copies are complete, and have room for h_alloc:
+    ea_type::hardware_type hw2(hw);
+    BOOST_CHECK(hw2 == hw);
+    BOOST_CHECK(hw2.repr().capacity() >= static_cast<std::size_t>(hw.repr().size() * 2.5));
+    
+    for(int i=hardware::MAX_STACK_SIZE+4; i>=5; --i) {
+        BOOST_CHECK_EQUAL(hw2.pop_stack(), i);
+    }
+    BOOST_CHECK(hw2.empty_stack());
+    std::pair<int,int> msg;
+    BOOST_CHECK(hw2.pop_msg(msg));
+    BOOST_CHECK_EQUAL(msg.first, 5);
+    BOOST_CHECK(!(hw2 == hw));
+    
+    // saving reads the hardware without changing it:
+    const ea_type::hardware_type& chw=hw;
+    std::ostringstream out;
+    {
+        boost::archive::xml_oarchive oa(out);
+        oa << boost::serialization::make_nvp("hardware", chw);
+    }
+    ea_type::hardware_type hw3;
+    std::istringstream in(out.str());
+    {
+        boost::archive::xml_iarchive ia(in);
+        ia >> boost::serialization::make_nvp("hardware", hw3);
+    }
+    BOOST_CHECK(hw3 == hw);
+    BOOST_CHECK_EQUAL(hw3.msgs_queued(), static_cast<std::size_t>(hardware::MAX_MSGS_QUEUED));
+}
+
+//! Deposits n messages (labeled with the sender) into a mailbox.
+struct mailbox_sender {
+    mailbox_sender(hardware& hw, int label, int n) : _hw(hw), _label(label), _n(n) { }
+    void operator()() {
+        for(int i=0; i<_n; ++i) {
+            _hw.deposit_message(_label, i);
+        }
+    }
+    hardware& _hw;
+    int _label;
+    int _n;
+};
+
+BOOST_AUTO_TEST_CASE(test_concurrent_messages) {
+    hardware hw;
+    boost::thread_group senders;
+    for(int i=0; i<4; ++i) {
+        senders.create_thread(mailbox_sender(hw, i, 10000));
+    }
+    // saving while messages are being deposited must not disturb the mailbox:
+    for(int i=0; i<20; ++i) {
+        std::ostringstream out;
+        boost::archive::xml_oarchive oa(out);
+        oa << boost::serialization::make_nvp("hardware", static_cast<const hardware&>(hw));
+    }
+    senders.join_all();
+    
+    // the mailbox holds the most recent messages, in the order each sender sent them:
+    BOOST_CHECK_EQUAL(hw.msgs_queued(), static_cast<std::size_t>(hardware::MAX_MSGS_QUEUED));
+    int last[4] = {-1, -1, -1, -1};
+    std::pair<int,int> msg;
+    std::size_t n=0;
+    while(hw.pop_msg(msg)) {
+        BOOST_REQUIRE((msg.first >= 0) && (msg.first < 4));
+        BOOST_CHECK(msg.second > last[msg.first]);
+        last[msg.first] = msg.second;
+        ++n;
+    }
+    BOOST_CHECK_EQUAL(n, static_cast<std::size_t>(hardware::MAX_MSGS_QUEUED));
+    BOOST_CHECK_EQUAL(hw.msgs_queued(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_environment_neighbors) {
+    // headings rotate ccw, starting from (1,0):
+    position_type pos(0,0);
+    int hx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+    int hy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+    for(int i=0; i<8; ++i) {
+        BOOST_CHECK_EQUAL(pos.heading(), i);
+        BOOST_CHECK_EQUAL(pos.h[0], hx[i]);
+        BOOST_CHECK_EQUAL(pos.h[1], hy[i]);
+        pos.rotate_ccw();
+    }
+    pos.rotate_cw();
+    BOOST_CHECK_EQUAL(pos.heading(), 7);
+    pos.rotate_cardinal_ccw();
+    BOOST_CHECK_EQUAL(pos.heading(), 1);
+    pos.rotate(-3.0 * M_PI/4.0);
+    BOOST_CHECK_EQUAL(pos.heading(), 6);
+    
+    // the neighborhood of a corner wraps around the torus:
+    ea_type ea(build_md());
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    ea_type::individual_type& ind=*ea.population()[0];
+    ind.position() = position_type(0,9,-1,0);
+    
+    typedef ea_type::environment_type::neighborhood_iterator neighborhood_iterator;
+    std::pair<neighborhood_iterator,neighborhood_iterator> ni=ea.env().neighborhood(ind);
+    for(int i=4; ni.first!=ni.second; ++ni.first, ++i) {
+        BOOST_CHECK_EQUAL(ni.first->r[0], (10 + hx[i%8]) % 10);
+        BOOST_CHECK_EQUAL(ni.first->r[1], (19 + hy[i%8]) % 10);
+    }
+    ea_type::environment_type::location_type& l=*ea.env().neighbor(ea.population()[0]);
+    BOOST_CHECK_EQUAL(l.r[0], 9);
+    BOOST_CHECK_EQUAL(l.r[1], 9);
+}
+
+BOOST_AUTO_TEST_CASE(test_location_data) {
+    ea_type ea(build_md());
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    ea_type::individual_ptr_type p=ea.population()[0];
+    ea_type::hardware_type& hw=p->hw();
+    p->position().heading(0);
+    
+    // int field 0 is used by the ldata instructions:
+    location_fields<int>& ld=ea.env().ldata().ints();
+    std::size_t here=ea.env().index(p->position());
+    std::size_t there=ea.env().index(position_type(1,0));
+    BOOST_CHECK(ld.find(LOCATION_DATA::key()) == location_data::LDATA);
+    BOOST_CHECK(!ld.exists(location_data::LDATA, here));
+    
+    instructions::latch_ldata<ea_type::hardware_type,ea_type> latch(1);
+    instructions::set_ldata<ea_type::hardware_type,ea_type> set(1);
+    instructions::get_ldata<ea_type::hardware_type,ea_type> get(1);
+    instructions::get_neighbor_ldata<ea_type::hardware_type,ea_type> get_neighbor(1);
+    
+    hw.setRegValue(hw.modifyRegister(), 7);
+    latch(hw, p, ea);
+    hw.setRegValue(hw.modifyRegister(), 8);
+    latch(hw, p, ea);
+    BOOST_CHECK(ld.get(location_data::LDATA, here) == 7);
+    set(hw, p, ea);
+    BOOST_CHECK(ld.get(location_data::LDATA, here) == 8);
+    hw.setRegValue(hw.modifyRegister(), 0);
+    get(hw, p, ea);
+    BOOST_CHECK(hw.getRegValue(hw.modifyRegister()) == 8);
+    
+    // the neighbor hasn't been set, so the register is unchanged:
+    get_neighbor(hw, p, ea);
+    BOOST_CHECK(hw.getRegValue(hw.modifyRegister()) == 8);
+    ld.set(location_data::LDATA, there, 9);
+    get_neighbor(hw, p, ea);
+    BOOST_CHECK(hw.getRegValue(hw.modifyRegister()) == 9);
+    
+    // other fields are registered by name:
+    location_fields<double>& dd=ea.env().ldata().doubles();
+    std::size_t f=dd.add("pheromone");
+    BOOST_CHECK(dd.add("pheromone") == f);
+    dd.set(f, there, 0.5);
+    
+    ea_type ea2;
+    std::ostringstream out;
+    checkpoint::save(out, ea);
+    std::istringstream in(out.str());
+    checkpoint::load(in, ea2);
+    BOOST_CHECK(ea.env() == ea2.env());
+    BOOST_CHECK(ea2.env().ldata().doubles().get(f, there) == 0.5);
+    
+    ea.env().ldata().reset();
+    BOOST_CHECK(!ld.exists(location_data::LDATA, here));
+    BOOST_CHECK(!dd.exists(f, there));
+}
+
+BOOST_AUTO_TEST_CASE(test_environment_version) {
+    ea_type ea(build_md()), ea2;
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    ea.env().ldata().ints().set(location_data::LDATA, 3, 7);
+    std::ostringstream out;
+    checkpoint::save(out, ea);
+    
+    // checkpoints from before typed location data (version 0) still load:
+    std::string xml=out.str();
+    std::size_t e=xml.find("<env ");
+    std::size_t v=xml.find("version=\"1\"", e);
+    BOOST_REQUIRE(v < xml.find(">", e));
+    xml.replace(v, 11, "version=\"0\"");
+    std::size_t b=xml.find("<ldata");
+    std::string end("</ldata>");
+    xml.erase(b, xml.find(end, b) + end.size() - b);
+    std::istringstream in(xml);
+    checkpoint::load(in, ea2);
+    BOOST_CHECK(ea2.population() == ea.population());
+    BOOST_CHECK(!ea2.env().ldata().ints().exists(location_data::LDATA, 3));
+    
+    // their location data was kept in location meta-data, and is moved:
+    ea_type ea3;
+    ea.env().ldata().reset();
+    put<LOCATION_DATA>(7, ea.env().location(0,3));
+    std::ostringstream out3;
+    checkpoint::save(out3, ea);
+    xml = out3.str();
+    e = xml.find("<env ");
+    v = xml.find("version=\"1\"", e);
+    xml.replace(v, 11, "version=\"0\"");
+    b = xml.find("<ldata");
+    xml.erase(b, xml.find(end, b) + end.size() - b);
+    std::istringstream in3(xml);
+    checkpoint::load(in3, ea3);
+    BOOST_CHECK(ea3.env().ldata().ints().exists(location_data::LDATA, 3));
+    BOOST_CHECK_EQUAL(ea3.env().ldata().ints().get(location_data::LDATA, 3), 7);
+    BOOST_CHECK(!exists<LOCATION_DATA>(ea3.env().location(0,3)));
+    ea2.env().ldata().ints().set(location_data::LDATA, 99, 1);
+    
+    // clearing the environment also clears its typed data:
+    ea.env().clear(ea);
+    BOOST_CHECK(!ea.env().ldata().ints().exists(location_data::LDATA, 3));
+}
+
+BOOST_AUTO_TEST_CASE(test_phenotype_version) {
+    ea_type ea(build_md()), ea2;
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    std::size_t nand=ea.tasklib().task("nand")->id();
+    ea.population()[0]->phenotype().add(nand, 2.5);
+    std::ostringstream out;
+    checkpoint::save(out, ea);
+    
+    // checkpoints from before task IDs (version 0) stored phenotypes as a map
+    // from task name to resources consumed:
+    std::string xml=out.str();
+    std::size_t b=xml.find("<phenotype ");
+    std::string end("</phenotype>");
+    BOOST_REQUIRE(b != std::string::npos);
+    xml.replace(b, xml.find(end, b) + end.size() - b,
+                "<phenotype class_id=\"99\" tracking_level=\"0\" version=\"0\">"
+                "<count>2</count><item_version>0</item_version>"
+                "<item class_id=\"100\" tracking_level=\"0\" version=\"0\"><first>nand</first><second>2.5</second></item>"
+                "<item><first>unknown</first><second>1</second></item>"
+                "</phenotype>");
+    std::istringstream in(xml);
+    checkpoint::load(in, ea2);
+    BOOST_REQUIRE(ea2.size() == 1);
+    task_phenotype& p=ea2.population()[0]->phenotype();
+    BOOST_CHECK(p == ea.population()[0]->phenotype());
+    BOOST_CHECK(p.performed(nand));
+    BOOST_CHECK_EQUAL(p.value(nand), 2.5);
+}
+
+BOOST_AUTO_TEST_CASE(test_sparse_environment) {
+    typedef digital_evolution
+    < test_lifecycle
+    , recombination::asexual
+    , weighted_round_robin< >
+    , selfrep_ancestor
+    , random_neighbor
+    , dont_stop
+    , generate_single_ancestor
+    , null_trait
+    , sparse_environment
+    > sparse_ea_type;
+    
+    // a 10,000 x 10,000 world:
+    metadata md=build_md();
+    put<SPATIAL_X>(10000,md);
+    put<SPATIAL_Y>(10000,md);
+    sparse_ea_type ea(md);
+    BOOST_CHECK(ea.env().stored() == 0);
+    
+    // neighbors wrap around the torus:
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    sparse_ea_type::individual_type& ind=ea[0];
+    BOOST_CHECK((ind.position().r[0] == 0) && (ind.position().r[1] == 0));
+    ind.position().heading(4);
+    sparse_ea_type::location_type& l=*ea.env().neighbor(ea.population()[0]);
+    BOOST_CHECK((l.r[0] == 9999) && (l.r[1] == 0));
+    BOOST_CHECK(!l.occupied());
+    
+    std::pair<sparse_ea_type::neighborhood_iterator,sparse_ea_type::neighborhood_iterator> ni=ea.env().neighborhood(ind);
+    BOOST_CHECK(&(*ni.first) == &l);
+    ++ni.first;
+    BOOST_CHECK((ni.first->r[0] == 9999) && (ni.first->r[1] == 9999));
+    std::size_t n=1;
+    for( ; ni.first!=ni.second; ++ni.first) {
+        BOOST_CHECK(!ni.first->occupied());
+        ++n;
+    }
+    BOOST_CHECK(n == 8);
+    BOOST_CHECK(ea.env().stored() == 9);
+    
+    // locations that are neither occupied nor annotated are dropped:
+    ea.env().location(5000,5000).md().set("annotation", "1");
+    ea.env().compact();
+    BOOST_CHECK(ea.env().stored() == 2);
+    
+    // memory grows with the population, not the world:
+    ea.clear();
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    put<SCHEDULER_TIME_SLICE>(30,ea);
+    ea.lifecycle().advance_epoch(100,ea);
+    BOOST_CHECK(ea.population().size() > 1);
+    ea.env().compact();
+    BOOST_CHECK(ea.env().stored() == ea.population().size() + 1);
+    for(sparse_ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        BOOST_CHECK(ea.env().location(i->position()).p.get() == &(*i));
+    }
+    
+    // checkpoint:
+    sparse_ea_type ea2;
+    std::ostringstream out;
+    checkpoint::save(out, ea);
+    std::istringstream in(out.str());
+    checkpoint::load(in, ea2);
+    BOOST_CHECK(ea.env() == ea2.env());
+    BOOST_CHECK(ea2.env().location(5000,5000).md().exists("annotation"));
+    ea.lifecycle().advance_epoch(10,ea);
+    ea2.lifecycle().advance_epoch(10,ea2);
+    BOOST_CHECK(ea.population() == ea2.population());
+    BOOST_CHECK(ea.env() == ea2.env());
+}
+
 BOOST_AUTO_TEST_CASE(test_avida_instructions) {
     ea_type ea(build_md());
     ea_type::isa_type& isa=ea.isa();
@@ -237,6 +697,66 @@ BOOST_AUTO_TEST_CASE(test_logic9_environment) {
     BOOST_CHECK(tequals(x, y, -4));
 }
 
+BOOST_AUTO_TEST_CASE(test_task_phenotype) {
+    ea_type ea(build_md());
+    
+    // tasks are numbered in the order they were added to the library:
+    BOOST_CHECK(ea.tasklib().tasks().size()==1);
+    BOOST_CHECK(ea.tasklib().task("nand")->id()==0);
+    BOOST_CHECK(!ea.tasklib().task("xor"));
+    
+    task_phenotype ph;
+    BOOST_CHECK(ph.empty());
+    ph.add(3, 0.0);
+    BOOST_CHECK(ph.performed(3) && !ph.consumed(3));
+    ph.add(3, 1.5);
+    ph.add(5, 2.0);
+    BOOST_CHECK(ph.consumed(3) && ph.consumed(5));
+    BOOST_CHECK(ph.value(3)==1.5);
+    BOOST_CHECK(ph.value(63)==0.0);
+    BOOST_CHECK(ph.performed_mask()==((1u<<3) | (1u<<5)));
+    BOOST_CHECK(ph.consumed_other(3));
+    
+    task_phenotype ph2(ph);
+    BOOST_CHECK(ph == ph2);
+    ph.clear();
+    BOOST_CHECK(ph.empty() && !ph.consumed_other(0));
+    BOOST_CHECK(!(ph == ph2));
+}
+
+
+BOOST_AUTO_TEST_CASE(test_task_logic_functions) {
+    typedef ea_type::task_library_type::task_ptr_type task_ptr_type;
+    typedef catalysts::additive<1> cat;
+    ea_type::task_library_type lib;
+    lib.append(task_ptr_type(new task<tasks::task_not,cat,ea_type>("not")));
+    lib.append(task_ptr_type(new task<tasks::task_nand,cat,ea_type>("nand")));
+    lib.append(task_ptr_type(new task<tasks::task_and,cat,ea_type>("and")));
+    lib.append(task_ptr_type(new task<tasks::task_ornot,cat,ea_type>("ornot")));
+    lib.append(task_ptr_type(new task<tasks::task_or,cat,ea_type>("or")));
+    lib.append(task_ptr_type(new task<tasks::task_andnot,cat,ea_type>("andnot")));
+    lib.append(task_ptr_type(new task<tasks::task_nor,cat,ea_type>("nor")));
+    lib.append(task_ptr_type(new task<tasks::task_xor,cat,ea_type>("xor")));
+    lib.append(task_ptr_type(new task<tasks::task_equals,cat,ea_type>("equals")));
+    lib.append(task_ptr_type(new task<tasks::task_true,cat,ea_type>("true")));
+    BOOST_CHECK(lib.tasks()[8]->logic()==tasks::EQU);
+    BOOST_CHECK(lib.tasks()[9]->logic()==0);
+    
+    // numbers 9, 10, as in test_logic9_environment:
+    BOOST_CHECK(lib.performed(9, 10, -4)==((1u<<8) | (1u<<9)));
+    BOOST_CHECK(lib.performed(9, 10, -10)==((1u<<0) | (1u<<9)));
+    BOOST_CHECK(lib.performed(9, 10, 1234)==(1u<<9));
+    
+    // the fused check is the same as checking each task:
+    default_rng_type rng(1);
+    for(int i=0; i<1000; ++i) {
+        int a=rng(), b=rng();
+        int f[] = { ~a, ~b, ~(a&b), a&b, a|~b, ~a|b, a|b, a&~b, ~a&b, ~(a|b), a^b, ~(a^b), a, b, 0, -1 };
+        for(std::size_t j=0; j<16; ++j) {
+            BOOST_CHECK(lib.performed(a, b, f[j]) == lib.performed_by_task(a, b, f[j]));
+        }
+    }
+}
 
 BOOST_AUTO_TEST_CASE(test_ea_type) {
     ea_type ea(build_md());
@@ -318,6 +838,474 @@ BOOST_AUTO_TEST_CASE(test_self_replication) {
     BOOST_CHECK(ea.population()[0]->hw() == ea.population()[1]->hw());
 }
 
+BOOST_AUTO_TEST_CASE(test_recycled_individuals) {
+    ea_type ea(build_md());
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea_type::genome_type r=ea.population()[0]->repr();
+    
+    // a dead individual that has lived a little:
+    ea_type::population_type pop;
+    pop.push_back(ea.make_individual(r));
+    pop.push_back(ea.make_individual(r));
+    ea_type::individual_type* dead=pop[1].get();
+    dead->inputs().push_back(1);
+    dead->outputs().push_back(2);
+    dead->priority() = 4.0;
+    dead->position() = position_type(3,4);
+    dead->hw().setRegValue(0, 5);
+    put<IND_GENERATION>(6.0, *dead);
+    dead->phenotype().add(0, 7.0);
+    dead->alive() = false;
+    
+    // pruning keeps it for reuse, and it is rebuilt as though it were new:
+    detail::prune(pop, ea);
+    BOOST_CHECK(pop.size() == 1);
+    ea_type::individual_ptr_type q=ea.make_individual(r.begin(), r.end());
+    BOOST_CHECK(q.get() == dead);
+    BOOST_CHECK(*q == *ea.make_individual(r));
+    BOOST_CHECK(q->phenotype().empty() && (q->phenotype().value(0) == 0.0));
+    
+    // individuals that are still referenced are not reused:
+    ea_type::individual_ptr_type held=q;
+    pop.push_back(q);
+    q->alive() = false;
+    detail::prune(pop, ea);
+    BOOST_CHECK(ea.make_individual(r.begin(), r.end()).get() != held.get());
+}
+
+//! Returns the size of a group.
+struct group_size {
+    template <typename EA>
+    double operator()(typename EA::individual_type& ind, EA& ea) {
+        return static_cast<double>(ind.size());
+    }
+};
+
+typedef metapopulation<ea_type> group_ea_type;
+
+//! Runs one round of group competition among 6 groups (of different sizes) on n threads.
+void compete_groups(unsigned int n, group_ea_type& mea) {
+    metadata md=build_md();
+    put<POPULATION_SIZE>(10,md);
+    put<SPATIAL_X>(5,md);
+    put<SPATIAL_Y>(2,md);
+    put<METAPOPULATION_SIZE>(6,md);
+    put<REPLACEMENT_RATE_P>(0.5,md);
+    put<METAPOP_COMPETITION_PERIOD>(1,md);
+    put<PARALLEL_THREADS>(n,md);
+    mea.initialize(md);
+    std::set<group_ea_type::individual_type*> groups;
+    for(std::size_t i=0; i<6; ++i) {
+        group_ea_type::individual_ptr_type g(new group_ea_type::individual_type(md));
+        generate_ancestors(repro_ancestor(), i+1, *g);
+        mea.population().push_back(g);
+        groups.insert(g.get());
+    }
+    meta_population_competition<group_size,group_ea_type> competition(0, mea);
+    competition(mea);
+    
+    // offspring reuse the groups that didn't survive:
+    BOOST_CHECK_EQUAL(mea.size(), 6u);
+    for(std::size_t i=0; i<mea.size(); ++i) {
+        BOOST_CHECK(groups.erase(mea.population()[i].get()) == 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_group_replication) {
+    group_ea_type m1, m4;
+    compete_groups(1, m1);
+    compete_groups(4, m4);
+    
+    // offspring are filled with copies of a germ:
+    for(std::size_t i=3; i<6; ++i) {
+        BOOST_CHECK_EQUAL(m1[i].size(), 10u);
+        for(std::size_t j=1; j<m1[i].size(); ++j) {
+            BOOST_CHECK(m1[i][j].repr() == m1[i][0].repr());
+        }
+    }
+    
+    // the number of threads doesn't matter:
+    for(std::size_t i=0; i<6; ++i) {
+        BOOST_CHECK_EQUAL(m1[i].size(), m4[i].size());
+        BOOST_CHECK(m1[i][0].repr() == m4[i][0].repr());
+    }
+    std::remove("meta_population_competition.dat");
+}
+
+BOOST_AUTO_TEST_CASE(test_group_reuse) {
+    metadata md=build_md();
+    put<POPULATION_SIZE>(10,md);
+    put<SPATIAL_X>(5,md);
+    put<SPATIAL_Y>(2,md);
+    put<MUTATION_PER_SITE_P>(0.05,md);
+    group_ea_type::individual_type parent(md);
+    generate_ancestors(repro_ancestor(), 1, parent);
+    
+    // a group that has lived for a while, and left state behind:
+    group_ea_type::individual_type used(md);
+    generate_ancestors(repro_ancestor(), 1, used);
+    used.population()[0]->priority() = 1.0;
+    used.lifecycle().advance_epoch(5, used);
+    used.md().set("test.flag", "1");
+    used.env().ldata().ints().set(location_data::LDATA, 0, 7);
+    used.env().location(0,0).md().set("test.flag", "1");
+    used.resources().clear();
+    
+    // once reset, it is replicated into just as a new group would be:
+    group_ea_type::individual_type fresh(md);
+    used.reset(md);
+    fresh.reset_rng(11);
+    used.reset_rng(11);
+    group_ea_type mea;
+    germline_replication(parent, fresh, mea);
+    germline_replication(parent, used, mea);
+    
+    BOOST_CHECK_EQUAL(used.current_update(), 0u);
+    BOOST_CHECK(!used.md().exists("test.flag"));
+    BOOST_CHECK(!used.env().ldata().ints().exists(location_data::LDATA, 0));
+    BOOST_CHECK(used.env().location(0,0).md().empty());
+    BOOST_CHECK_EQUAL(used.size(), fresh.size());
+    for(std::size_t i=0; i<used.size(); ++i) {
+        BOOST_CHECK(used[i].repr() == fresh[i].repr());
+        BOOST_CHECK(used[i].position() == fresh[i].position());
+    }
+    BOOST_CHECK_EQUAL(used.rng()(1000), fresh.rng()(1000));
+}
+
+typedef digital_evolution
+< test_lifecycle
+, recombination::asexual
+, weighted_round_robin< >
+, selfrep_ancestor
+, random_neighbor
+, dont_stop
+, generate_single_ancestor
+, genotype_trait
+> gt_ea_type;
+
+BOOST_AUTO_TEST_CASE(test_genotype_table) {
+    typedef genotype_table<gt_ea_type> table_type;
+    
+    gt_ea_type ea(build_md());
+    put<MUTATION_PER_SITE_P>(0.0,ea);
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    
+    table_type table(ea);
+    BOOST_CHECK(table.size() == 1);
+    BOOST_CHECK(table.intern(ea.population()[0]->repr(),ea) == ea.population()[0]->traits().genotype());
+    
+    // without mutations, every organism shares the ancestor's genotype:
+    ea.lifecycle().advance_epoch(20,ea);
+    BOOST_CHECK(ea.population().size() > 1);
+    BOOST_CHECK(table.size() == 1);
+    BOOST_CHECK(table_type::abundance(*table.begin()) == ea.population().size());
+    BOOST_CHECK((*table.dominant())->first_update() == 0);
+    BOOST_CHECK((*table.dominant())->total() >= ea.population().size());
+    
+    // with mutations, abundances still account for every organism:
+    put<MUTATION_PER_SITE_P>(0.05,ea);
+    ea.lifecycle().advance_epoch(50,ea);
+    BOOST_CHECK(table.size() > 1);
+    std::size_t n=0;
+    for(table_type::iterator i=table.begin(); i!=table.end(); ++i) {
+        BOOST_CHECK(table_type::abundance(*i) > 0);
+        n += table_type::abundance(*i);
+    }
+    std::size_t m=0;
+    for(gt_ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        if(i->traits().genotype()) {
+            ++m;
+        }
+    }
+    BOOST_CHECK(n == m);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_genotype_table) {
+    typedef gt_ea_type::genotype_table_type table_type;
+    
+    gt_ea_type ea(build_md());
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    
+    // everything that tracks genotypes shares the EA's table:
+    datafiles::genotypes<gt_ea_type> g(ea);
+    datafiles::dominant_phenotype<gt_ea_type> d(ea);
+    BOOST_CHECK(&g.table() == &ea.genotypes());
+    BOOST_CHECK(&d.table() == &ea.genotypes());
+    
+    ea.lifecycle().advance_epoch(20,ea);
+    std::size_t n=0;
+    for(table_type::iterator i=ea.genotypes().begin(); i!=ea.genotypes().end(); ++i) {
+        n += table_type::abundance(*i);
+    }
+    BOOST_CHECK(ea.population().size() > 1);
+    BOOST_CHECK(n == ea.population().size());
+    std::remove("genotypes.dat");
+    std::remove("dominant_phenotype.dat");
+}
+
+BOOST_AUTO_TEST_CASE(test_test_cpu) {
+    ea_type ea(build_md());
+    generate_ancestors(selfrep_ancestor(), 1, ea);
+    generate_ancestors(repro_ancestor(), 1, ea);
+    generate_ancestors(nopx_ancestor(), 1, ea);
+    
+    std::vector<ea_type::genome_type> genomes;
+    for(ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        genomes.push_back(i->repr());
+    }
+    
+    test_cpu<ea_type> cpu(ea);
+    test_phenotype p=cpu.evaluate(genomes[0]);
+    BOOST_CHECK(p.viable);
+    BOOST_CHECK(p.cycles > 0);
+    BOOST_CHECK(p.offspring_size == genomes[0].size());
+    BOOST_CHECK(p.fidelity == 1.0);
+    BOOST_CHECK(cpu.evaluate(genomes[1]).viable);
+    BOOST_CHECK(!cpu.evaluate(genomes[2]).viable);
+    BOOST_CHECK(cpu.size() == 3);
+    BOOST_CHECK(ea.population().size() == 3); // the world is untouched
+    
+    // cached and parallel evaluations give the same phenotypes:
+    put<PARALLEL_THREADS>(2,ea);
+    test_cpu<ea_type> pcpu(ea);
+    pcpu.evaluate(genomes.begin(), genomes.end());
+    BOOST_CHECK(pcpu.size() == 3);
+    for(std::size_t i=0; i<genomes.size(); ++i) {
+        BOOST_CHECK(pcpu.evaluate(genomes[i]) == cpu.evaluate(genomes[i]));
+    }
+}
+
+struct ldata_lifecycle : test_lifecycle {
+    template <typename EA>
+    void after_initialization(EA& ea) {
+        test_lifecycle::after_initialization(ea);
+        append_isa<instructions::get_ldata>(ea);
+    }
+};
+
+typedef digital_evolution
+< ldata_lifecycle
+> ld_ea_type;
+
+//! Test CPU that exposes its test worlds.
+struct open_test_cpu : test_cpu<ld_ea_type> {
+    open_test_cpu(ld_ea_type& ea) : test_cpu<ld_ea_type>(ea) {
+    }
+    using test_cpu<ld_ea_type>::acquire;
+    using test_cpu<ld_ea_type>::release;
+    using test_cpu<ld_ea_type>::run;
+};
+
+BOOST_AUTO_TEST_CASE(test_test_cpu_reset) {
+    ld_ea_type ea(build_md());
+    
+    // cx=ldata (if set); bx=input; bx=nand(bx,cx); output bx:
+    ld_ea_type::genome_type g(50);
+    std::fill(g.begin(), g.end(), ea.isa()["nop_x"]);
+    g[0] = ea.isa()["get_ldata"];
+    g[1] = ea.isa()["nop_c"];
+    g[2] = ea.isa()["input"];
+    g[3] = ea.isa()["nand"];
+    g[4] = ea.isa()["output"];
+    
+    open_test_cpu cpu(ea);
+    ld_ea_type* w=cpu.acquire();
+    test_phenotype fresh=cpu.run(g, *w);
+    BOOST_CHECK(fresh.tasks == 0);
+    
+    // state left behind in the test world by an earlier run must not leak
+    // into the next one:
+    std::size_t c=w->env().index(position_type(1,1));
+    w->env().ldata().ints().set(location_data::LDATA, c, static_cast<int>(open_test_cpu::INPUT1));
+    w->env().location(1,1).md().set("test.flag", "1");
+    w->resources().clear();
+    BOOST_CHECK(cpu.run(g, *w) == fresh);
+    BOOST_CHECK(!w->env().ldata().ints().exists(location_data::LDATA, c));
+    BOOST_CHECK(w->env().location(1,1).md().empty());
+    cpu.release(w);
+}
+
+BOOST_AUTO_TEST_CASE(test_execution_trace) {
+    ea_type ea(build_md());
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    boost::uint32_t id=ea_type::trace_type::organism_id(*ea.population()[0]);
+    
+    std::size_t n=0;
+    {
+        ea_type::trace_type t("test_trace.gz", ea, 64);
+        ea.lifecycle().advance_epoch(5,ea);
+        n = t.size();
+    }
+    BOOST_CHECK(ea.trace() == 0);
+    BOOST_CHECK(ea.population().size() > 1);
+    
+    trace_statistics s("test_trace.gz");
+    BOOST_CHECK(n > 0);
+    BOOST_CHECK(s.records == n);
+    BOOST_CHECK(s.executed[ea.isa()["repro"]] > 0);
+    BOOST_CHECK(s.executed_by(ea.isa()["repro"]) >= 1);
+    
+    // only the ancestor:
+    {
+        ea_type::trace_type t("test_trace.gz", ea, 64);
+        t.add_organism(id);
+        ea.lifecycle().advance_epoch(2,ea);
+    }
+    trace_reader r("test_trace.gz");
+    trace_record rec;
+    std::size_t m=0;
+    while(r.read(rec)) {
+        BOOST_CHECK(rec.organism == id);
+        ++m;
+    }
+    BOOST_CHECK(m > 0);
+    std::remove("test_trace.gz");
+}
+
+BOOST_AUTO_TEST_CASE(test_instruction_profile) {
+    ea_type ea(build_md());
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    
+    {
+        ea_type::profile_type prof(ea, 1);
+        BOOST_CHECK(ea.profile() == &prof);
+        ea.lifecycle().advance_epoch(5,ea);
+        
+        ea_type::profile_type::counters c=prof.collect();
+        BOOST_CHECK(c.executed.size() == ea.isa().size());
+        BOOST_CHECK(c.executed[ea.isa()["repro"]] > 0);
+        unsigned long executed=0, cycles=0;
+        double seconds=0.0;
+        for(std::size_t i=0; i<c.executed.size(); ++i) {
+            executed += c.executed[i];
+            cycles += c.cycles[i];
+            seconds += c.seconds[i];
+        }
+        BOOST_CHECK(executed > 0);
+        BOOST_CHECK(cycles >= executed); // all instructions cost at least one cycle
+        BOOST_CHECK(seconds > 0.0);
+        
+        c = prof.collect();
+        BOOST_CHECK(c.executed[ea.isa()["repro"]] == 0);
+    }
+    BOOST_CHECK(ea.profile() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_weighted_random_scheduler) {
+    double w[] = { 1.0, 0.0, 2.0, 3.0 };
+    fenwick_tree t;
+    t.assign(w, w+4);
+    BOOST_CHECK(t.total() == 6.0);
+    BOOST_CHECK(t.find(0.0) == 0);
+    BOOST_CHECK(t.find(0.99) == 0);
+    BOOST_CHECK(t.find(1.0) == 2);
+    BOOST_CHECK(t.find(2.99) == 2);
+    BOOST_CHECK(t.find(3.0) == 3);
+    BOOST_CHECK(t.find(5.99) == 3);
+    BOOST_CHECK(t.find(6.0) == 3); // rounding
+    t.update(1, 4.0);
+    BOOST_CHECK(t.total() == 10.0);
+    BOOST_CHECK(t.find(1.5) == 1);
+    BOOST_CHECK(t.nonzero() == 4);
+    t.update(0, 0.0);
+    BOOST_CHECK(t.nonzero() == 3);
+    
+    typedef digital_evolution
+    < test_lifecycle
+    , recombination::asexual
+    , weighted_random< >
+    > wr_ea_type;
+    
+    wr_ea_type ea(build_md());
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    ea.lifecycle().advance_epoch(100,ea);
+    BOOST_CHECK(ea.population().size() > 1);
+    BOOST_CHECK(ea.population().size() <= 100);
+    for(wr_ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+        BOOST_CHECK(i->alive());
+    }
+}
+
+//! Kills the organism that executes it.
+DIGEVO_INSTRUCTION_DECL(die) {
+    p->alive() = false;
+}
+
+struct mortal_lifecycle : test_lifecycle {
+    template <typename EA>
+    void after_initialization(EA& ea) {
+        test_lifecycle::after_initialization(ea);
+        append_isa<die>(ea);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_weighted_random_extinction) {
+    typedef digital_evolution
+    < mortal_lifecycle
+    , recombination::asexual
+    , weighted_random< >
+    > wr_ea_type;
+    
+    // when the whole population dies during an update, rounding in the total
+    // priority must not keep the scheduler choosing dead organisms:
+    for(int t=0; t<50; ++t) {
+        metadata md=build_md();
+        put<RNG_SEED>(t+1,md);
+        wr_ea_type ea(md);
+        generate_ancestors(nopx_ancestor(), 20, ea);
+        for(wr_ea_type::iterator i=ea.begin(); i!=ea.end(); ++i) {
+            i->priority() = ea.rng().uniform_real(0.1, 1.0);
+            i->repr()[ea.rng()(10)] = ea.isa()["die"];
+        }
+        ea.lifecycle().advance_epoch(1,ea);
+        BOOST_CHECK(ea.population().empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_tiled_scheduler) {
+    BOOST_CHECK(detail::tile_count(10,8) == 1);
+    BOOST_CHECK(detail::tile_count(16,4) == 4);
+    BOOST_CHECK(detail::tile_count(15,4) == 2);
+    BOOST_CHECK(detail::tile_count(16,1) == 8);
+    
+    typedef digital_evolution
+    < test_lifecycle
+    , recombination::asexual
+    , tiled_round_robin< >
+    > tiled_ea_type;
+    
+    // the same seed should give the same world, regardless of threads:
+    metadata md=build_md();
+    put<POPULATION_SIZE>(256,md);
+    put<SPATIAL_X>(16,md);
+    put<SPATIAL_Y>(16,md);
+    put<SCHEDULER_TILE_SIZE>(4,md);
+    
+    tiled_ea_type ea1(md), ea4(md);
+    put<PARALLEL_THREADS>(4,ea4);
+    generate_ancestors(repro_ancestor(), 4, ea1);
+    generate_ancestors(repro_ancestor(), 4, ea4);
+    for(std::size_t i=0; i<4; ++i) {
+        ea1.population()[i]->priority() = 1.0;
+        ea4.population()[i]->priority() = 1.0;
+    }
+    ea1.lifecycle().advance_epoch(100,ea1);
+    ea4.lifecycle().advance_epoch(100,ea4);
+    
+    BOOST_CHECK(ea1.population().size() > 4);
+    BOOST_CHECK(ea1.population() == ea4.population());
+    BOOST_CHECK(ea1.env() == ea4.env());
+    BOOST_CHECK(ea1.rng() == ea4.rng());
+    for(tiled_ea_type::iterator i=ea4.begin(); i!=ea4.end(); ++i) {
+        BOOST_CHECK(i->alive());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_al_messaging) {
     ea_type ea(build_md());
     generate_ancestors(nopx_ancestor(), 2, ea);
@@ -371,3 +1359,38 @@ BOOST_AUTO_TEST_CASE(test_digevo_checkpoint) {
     BOOST_CHECK(ea.env() == ea2.env());
     BOOST_CHECK(ea.rng() == ea2.rng());
 }
+
+BOOST_AUTO_TEST_CASE(test_digevo_binary_checkpoint) {
+    ea_type ea(build_md()), ea2, ea3;
+    
+    generate_ancestors(repro_ancestor(), 1, ea);
+    ea.population()[0]->priority() = 1.0;
+    ea.lifecycle().advance_epoch(400,ea);
+    ea.env().location(3,4).md().set("annotation", "1");
+    
+    std::ostringstream xml, bin;
+    checkpoint::save(xml, ea);
+    checkpoint::save(bin, ea, checkpoint::BINARY);
+    BOOST_CHECK(bin.str().size() < xml.str().size());
+    
+    // the format is detected on load:
+    std::istringstream in(bin.str());
+    checkpoint::load(in, ea2);
+    BOOST_CHECK(ea.population() == ea2.population());
+    BOOST_CHECK(ea.env() == ea2.env());
+    BOOST_CHECK(ea.rng() == ea2.rng());
+    BOOST_CHECK(ea2.env().location(3,4).md().exists("annotation"));
+    BOOST_CHECK(!ea2.env().location(4,3).md().exists("annotation"));
+    
+    // ... as is compression:
+    checkpoint::save("test_checkpoint.bin.gz", ea);
+    checkpoint::load("test_checkpoint.bin.gz", ea3);
+    std::remove("test_checkpoint.bin.gz");
+    BOOST_CHECK(ea.population() == ea3.population());
+    BOOST_CHECK(ea.env() == ea3.env());
+    
+    ea.lifecycle().advance_epoch(10,ea);
+    ea2.lifecycle().advance_epoch(10,ea2);
+    BOOST_CHECK(ea.population() == ea2.population());
+    BOOST_CHECK(ea.rng() == ea2.rng());
+}
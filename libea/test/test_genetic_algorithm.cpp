@@ -25,3 +25,219 @@ BOOST_AUTO_TEST_CASE(test_genetic_algorithm) {
     all_ones_ea ea(build_ea_md());
     ea.lifecycle().advance_epoch(10,ea);
 }
+
+#include <ea/genome_types/realstring.h>
+#include <ea/fitness_functions/benchmarks.h>
+#include <ea/generational_models/evolution_strategy.h>
+#include <ea/generational_models/moran_process.h>
+
+BOOST_AUTO_TEST_CASE(test_double_buffered_models) {
+    using namespace ealib;
+    typedef evolutionary_algorithm
+    < direct<bitstring>
+    , all_ones
+    , mutation::operators::per_site<mutation::site::bitflip>
+    , recombination::two_point_crossover
+    , generational_models::generational< >
+    , ancestors::random_bitstring
+    > gen_ea_type;
+    
+    typedef evolutionary_algorithm
+    < direct<bitstring>
+    , all_ones
+    , mutation::operators::per_site<mutation::site::bitflip>
+    , recombination::two_point_crossover
+    , generational_models::moran_process< >
+    , ancestors::random_bitstring
+    > moran_ea_type;
+    
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(100,md);
+    put<MORAN_REPLACEMENT_RATE_P>(0.1,md);
+    
+    gen_ea_type ea1(md);
+    generate_initial_population(ea1);
+    ea1.lifecycle().advance_epoch(10,ea1);
+    BOOST_CHECK_EQUAL(ea1.size(), 100u);
+    BOOST_CHECK(ea1.buffer().empty());
+    
+    moran_ea_type ea2(md);
+    generate_initial_population(ea2);
+    ea2.lifecycle().advance_epoch(10,ea2);
+    BOOST_CHECK_EQUAL(ea2.size(), 100u);
+    BOOST_CHECK(ea2.buffer().empty());
+    
+    all_ones_ea ea3(build_ea_md());
+    generate_initial_population(ea3);
+    ea3.lifecycle().advance_epoch(10,ea3);
+    BOOST_CHECK_EQUAL(ea3.size(), 1024u);
+    BOOST_CHECK(ea3.buffer().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_evolution_strategy) {
+    using namespace ealib;
+    typedef evolutionary_algorithm
+    < direct<realstring>
+    , griewangk
+    , mutation::operators::per_site<mutation::site::relative_normal_real>
+    , recombination::two_point_crossover
+    , generational_models::evolution_strategy<generational_models::plusS>
+    , ancestors::uniform_real
+    > ea_type;
+    
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(10,md);
+    put<ES_MU>(10,md);
+    put<ES_LAMBDA>(20,md);
+    put<ES_RHO>(4,md);
+    put<MUTATION_PER_SITE_P>(0.5,md);
+    put<MUTATION_NORMAL_REAL_VAR>(0.5,md);
+    put<MUTATION_UNIFORM_REAL_MIN>(-10.0,md);
+    put<MUTATION_UNIFORM_REAL_MAX>(10.0,md);
+    
+    ea_type ea(md);
+    generate_initial_population(ea);
+    double f0=ealib::fitness(**std::min_element(ea.population().begin(), ea.population().end(), comparators::fitness<ea_type>(ea)), ea);
+    ea.lifecycle().advance_epoch(20,ea);
+    double f1=ealib::fitness(**std::min_element(ea.population().begin(), ea.population().end(), comparators::fitness<ea_type>(ea)), ea);
+    
+    BOOST_CHECK_EQUAL(ea.size(), 10u);
+    BOOST_CHECK(f1 <= f0);
+}
+
+#include <ea/generational_models/incremental_steady_state.h>
+
+BOOST_AUTO_TEST_CASE(test_incremental_steady_state) {
+    using namespace ealib;
+    typedef evolutionary_algorithm
+    < direct<bitstring>
+    , all_ones
+    , mutation::operators::per_site<mutation::site::bitflip>
+    , recombination::two_point_crossover
+    , generational_models::incremental_steady_state
+    , ancestors::random_bitstring
+    > ea_type;
+    
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(100,md);
+    put<STEADY_STATE_LAMBDA>(1,md);
+    
+    ea_type ea(md);
+    generate_initial_population(ea);
+    ea.lifecycle().advance_epoch(50,ea);
+    BOOST_CHECK_EQUAL(ea.size(), 100u);
+    
+    // the index agrees with the population:
+    generational_models::incremental_steady_state& gm=ea.generational_model();
+    double worst=ealib::fitness(ea[gm.worst()],ea);
+    double best=ealib::fitness(ea[gm.best()],ea);
+    for(std::size_t i=0; i<ea.size(); ++i) {
+        BOOST_CHECK(ealib::fitness(ea[i],ea) >= worst);
+        BOOST_CHECK(ealib::fitness(ea[i],ea) <= best);
+    }
+    BOOST_CHECK_EQUAL(gm.rank(gm.best()), 99u);
+    
+    // nullified fitnesses force a rebuild:
+    nullify_fitness(ea.begin(), ea.end(), ea);
+    ea.lifecycle().advance_epoch(5,ea);
+    BOOST_CHECK_EQUAL(gm.ranks().size(), 100u);
+    BOOST_CHECK_EQUAL(gm.rank(gm.worst()), 0u);
+}
+
+#include <ea/generational_models/cma_es.h>
+
+template <typename Covariance>
+void run_cma_es(double& f0, double& f1, std::size_t& n) {
+    using namespace ealib;
+    typedef evolutionary_algorithm
+    < direct<realstring>
+    , griewangk
+    , mutation::operators::per_site<mutation::site::relative_normal_real>
+    , recombination::asexual
+    , generational_models::cma_es<Covariance>
+    , ancestors::uniform_real
+    > ea_type;
+    
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(5,md);
+    put<REPRESENTATION_SIZE>(8,md);
+    put<ES_MU>(5,md);
+    put<ES_LAMBDA>(10,md);
+    put<CMA_ES_SIGMA>(2.0,md);
+    put<MUTATION_UNIFORM_REAL_MIN>(-10.0,md);
+    put<MUTATION_UNIFORM_REAL_MAX>(10.0,md);
+    
+    ea_type ea(md);
+    generate_initial_population(ea);
+    f0=ealib::fitness(**std::min_element(ea.population().begin(), ea.population().end(), comparators::fitness<ea_type>(ea)), ea);
+    ea.lifecycle().advance_epoch(200,ea);
+    f1=ealib::fitness(**std::min_element(ea.population().begin(), ea.population().end(), comparators::fitness<ea_type>(ea)), ea);
+    n=ea.size();
+}
+
+BOOST_AUTO_TEST_CASE(test_cma_es) {
+    using namespace ealib;
+    double f0, f1;
+    std::size_t n;
+    run_cma_es<generational_models::full_covarianceS>(f0, f1, n);
+    BOOST_CHECK_EQUAL(n, 5u);
+    BOOST_CHECK(f1 < f0);
+    BOOST_CHECK(f1 < 0.1);
+    
+    run_cma_es<generational_models::diagonal_covarianceS>(f0, f1, n);
+    BOOST_CHECK_EQUAL(n, 5u);
+    BOOST_CHECK(f1 < f0);
+    BOOST_CHECK(f1 < 0.1);
+}
+
+#include <ea/fitness_functions/all_ones.h>
+#include <ea/nsga2.h>
+
+BOOST_AUTO_TEST_CASE(test_nsga2) {
+    using namespace ealib;
+    typedef evolutionary_algorithm
+    < direct<bitstring>
+    , multi_all_ones
+    , mutation::operators::per_site<mutation::site::bitflip>
+    , recombination::two_point_crossover
+    , generational_models::nsga2
+    , ancestors::random_bitstring
+    , dont_stop
+    , fill_population
+    , default_lifecycle
+    , nsga2_traits
+    > ea_type;
+    
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(40,md);
+    put<REPRESENTATION_SIZE>(4,md);
+    
+    ea_type ea(md);
+    generate_initial_population(ea);
+    ea.lifecycle().advance_epoch(5,ea);
+    BOOST_CHECK_EQUAL(ea.size(), 40u);
+    BOOST_CHECK(ea.buffer().empty());
+    
+    // crowding distance, checked by hand on a single front:
+    ea_type::population_type I;
+    int g[4][4] = {{1,0,0,1}, {0,1,1,0}, {1,1,0,0}, {0,0,1,1}};
+    for(std::size_t i=0; i<4; ++i) {
+        I.push_back(ea.make_individual(ea_type::genome_type(g[i], g[i]+4)));
+    }
+    ea_type::population_type I0(I);
+    selection::nsga2 s(0, I, ea);
+    s.crowding_distance(I, ea);
+    BOOST_CHECK(std::equal(I.begin(), I.end(), I0.begin())); // not reordered
+    // (multi_all_ones only reports its first objective):
+    BOOST_CHECK_EQUAL(I[0]->traits().distance, 1.0);
+    BOOST_CHECK_EQUAL(I[1]->traits().distance, std::numeric_limits<double>::max());
+    BOOST_CHECK_EQUAL(I[2]->traits().distance, std::numeric_limits<double>::max());
+    BOOST_CHECK_EQUAL(I[3]->traits().distance, 1.0);
+    
+    // keys are ordered worst-to-best:
+    crowding_comparator<access::traits,ea_type> cmp(ea);
+    BOOST_CHECK(cmp(crowding_key(1,5.0,0), crowding_key(0,1.0,1)));
+    BOOST_CHECK(cmp(crowding_key(0,1.0,0), crowding_key(0,5.0,1)));
+    BOOST_CHECK(cmp(crowding_key(0,1.0,1), crowding_key(0,1.0,0)));
+    BOOST_CHECK(!cmp(crowding_key(0,1.0,0), crowding_key(0,1.0,1)));
+}
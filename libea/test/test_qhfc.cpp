@@ -48,3 +48,34 @@ BOOST_AUTO_TEST_CASE(test_qhfc) {
     generate_initial_population(ea);
     ea.lifecycle().advance_epoch(10,ea);
 }
+
+BOOST_AUTO_TEST_CASE(test_parallel_crowding) {
+    typedef evolutionary_algorithm
+    < direct<bitstring>
+    , all_ones
+    , mutation::operators::per_site<mutation::site::bitflip>
+    , recombination::two_point_crossover
+    , generational_models::deterministic_crowding< >
+    , ancestors::random_bitstring
+    > ea_type;
+
+    metadata md=build_ea_md();
+    put<POPULATION_SIZE>(100,md);
+    put<RNG_SEED>(1,md);
+    
+    ea_type ea1(md);
+    generate_initial_population(ea1);
+    ea1.lifecycle().advance_epoch(10,ea1);
+
+    put<PARALLEL_THREADS>(4,md);
+    ea_type ea4(md);
+    generate_initial_population(ea4);
+    ea4.lifecycle().advance_epoch(10,ea4);
+    
+    // same seed, same population, regardless of thread count:
+    BOOST_CHECK_EQUAL(ea1.size(), 100u);
+    BOOST_CHECK_EQUAL(ea4.size(), 100u);
+    for(std::size_t i=0; i<ea1.size(); ++i) {
+        BOOST_CHECK(ea1[i].genome() == ea4[i].genome());
+    }
+}